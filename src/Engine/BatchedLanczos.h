@@ -0,0 +1,142 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file BatchedLanczos.h
+ *
+ *  Lanczos tridiagonal decompositions of several initial vectors with
+ *  the same Hamiltonian, advanced in lockstep
+ *
+ *  Each step does a single lanczosStepBlock for all vectors still
+ *  running, so the Hamiltonian is read once per step instead of once per
+ *  vector, and the recursion is done with the product, see LanczosStep.h.
+ *  Each decomposition follows the same recursion as
+ *  PsimagLite::LanczosSolver::decomposition, and stops after steps
+ *  steps or when its b is below eps
+ *
+ */
+#ifndef BATCHED_LANCZOS_H
+#define BATCHED_LANCZOS_H
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cassert>
+
+namespace LanczosPlusPlus {
+
+	template<typename InternalProductType,
+	         typename VectorType,
+	         typename TridiagonalMatrixType,
+	         typename RealType>
+	class BatchedLanczos {
+
+		typedef typename VectorType::value_type FieldType;
+
+	public:
+
+		BatchedLanczos(const InternalProductType& matrix,size_t steps,RealType eps)
+		: matrix_(matrix),steps_(steps),eps_(eps)
+		{}
+
+		//! ab[v] is the decomposition of initVectors[v]
+		void decomposition(const std::vector<VectorType>& initVectors,
+		                   std::vector<TridiagonalMatrixType>& ab) const
+		{
+			size_t n = matrix_.rank();
+			ab.clear();
+			ab.resize(initVectors.size());
+
+			// vectors that are still running, and which decomposition they are
+			std::vector<VectorType> x;
+			std::vector<VectorType> y;
+			std::vector<size_t> index;
+			// so that x and y are not copied after they are placed
+			x.reserve(initVectors.size());
+			y.reserve(initVectors.size());
+			for (size_t v=0;v<initVectors.size();v++) {
+				assert(initVectors[v].size()==n);
+				RealType norm = std::sqrt(dot(initVectors[v],initVectors[v]));
+				if (norm==0) continue;
+				x.push_back(VectorType(n,0));
+				y.push_back(initVectors[v]);
+				for (size_t i=0;i<n;i++) y.back()[i] /= norm;
+				index.push_back(v);
+			}
+			for (size_t v=0;v<x.size();v++) {
+				matrix_.numaPlace(x[v]);
+				matrix_.numaPlace(y[v]);
+			}
+
+			std::vector<RealType> a;
+			std::vector<RealType> b(x.size(),0);
+			for (size_t step=0;step<steps_ && x.size()>0;step++) {
+				matrix_.lanczosStepBlock(x,y,a,b,eps_);
+				size_t v = 0;
+				while (v<x.size()) {
+					ab[index[v]].push(a[v],b[v]);
+					if (b[v]>=eps_) {
+						v++;
+						continue;
+					}
+					// this one is done
+					x[v].swap(x.back());
+					y[v].swap(y.back());
+					index[v] = index.back();
+					a[v] = a.back();
+					b[v] = b.back();
+					x.pop_back();
+					y.pop_back();
+					index.pop_back();
+					a.pop_back();
+					b.pop_back();
+				}
+			}
+		}
+
+	private:
+
+		static RealType dot(const VectorType& a,const VectorType& b)
+		{
+			RealType sum = 0;
+			for (size_t i=0;i<a.size();i++) sum += realOfProduct(a[i],b[i]);
+			return sum;
+		}
+
+		template<typename T>
+		static RealType realOfProduct(const T& a,const T& b)
+		{
+			return a*b;
+		}
+
+		template<typename T>
+		static RealType realOfProduct(const std::complex<T>& a,const std::complex<T>& b)
+		{
+			return std::real(std::conj(a)*b);
+		}
+
+		const InternalProductType& matrix_;
+		size_t steps_;
+		RealType eps_;
+	}; // class BatchedLanczos
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // BATCHED_LANCZOS_H
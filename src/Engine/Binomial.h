@@ -0,0 +1,71 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file Binomial.h
+ *
+ *  Table of binomial coefficients C(n,k) for 0<=n,k<=nmax, with
+ *  C(n,k)=0 for k>n
+ *
+ *  It is filled once by its constructor and not changed after, so a
+ *  basis can own one and be built and used by several threads at once
+ *
+ */
+#ifndef BINOMIAL_H
+#define BINOMIAL_H
+#include <vector>
+#include <cassert>
+
+namespace LanczosPlusPlus {
+
+	class Binomial {
+
+	public:
+
+		Binomial(size_t nmax=0)
+		: nmax_(nmax),data_((nmax+1)*(nmax+1),0)
+		{
+			// Pascal's triangle
+			for (size_t n=0;n<=nmax_;n++) {
+				data_[n*(nmax_+1)] = 1;
+				for (size_t k=1;k<=n;k++)
+					data_[n*(nmax_+1)+k] = data_[(n-1)*(nmax_+1)+k-1] +
+					                       data_[(n-1)*(nmax_+1)+k];
+			}
+		}
+
+		size_t operator()(size_t n,size_t k) const
+		{
+			assert(n<=nmax_ && k<=nmax_);
+			return data_[n*(nmax_+1)+k];
+		}
+
+		size_t nmax() const { return nmax_; }
+
+	private:
+
+		size_t nmax_;
+		std::vector<size_t> data_;
+	}; // class Binomial
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // BINOMIAL_H
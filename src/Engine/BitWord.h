@@ -0,0 +1,234 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file BitWord.h
+ *
+ *  Operations on the word that holds the occupations of a basis state,
+ *  for each type of word the bases can use
+ *
+ *  unsigned long long gives 64 spin-orbitals, unsigned __int128, where
+ *  the compiler has it, 128, and MultiWord<N> N*64. The word is chosen
+ *  at build time, with -DUSE_WORD128 or -DUSE_MULTIWORD=N (see
+ *  configure.pl and lanczos.cpp). bit() and lowMask() can be asked for
+ *  any number of bits up to the width of the word, unlike 1<<n
+ *
+ */
+#ifndef BIT_WORD_H
+#define BIT_WORD_H
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include "BitManip.h"
+#include "MultiWord.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename WordType>
+	class BitWord;
+
+	template<>
+	class BitWord<unsigned long long> {
+
+		typedef unsigned long long WordType;
+
+	public:
+
+		enum {BITS=64};
+
+		static size_t count(WordType w)
+		{
+			return PsimagLite::BitManip::count(w);
+		}
+
+		static size_t parity(WordType w)
+		{
+#ifdef __GNUC__
+			return __builtin_parityll(w);
+#else
+			return (count(w) & 1);
+#endif
+		}
+
+		//! The lowest bits of w, as many as size_t holds
+		static size_t low(WordType w)
+		{
+			return size_t(w);
+		}
+
+		static WordType bit(size_t i)
+		{
+			return (i<size_t(BITS)) ? (WordType(1)<<i) : 0;
+		}
+
+		//! The lowest n bits set
+		static WordType lowMask(size_t n)
+		{
+			return (n>=size_t(BITS)) ? ~WordType(0) : (WordType(1)<<n) - 1;
+		}
+
+		static void print(std::ostream& os,WordType w)
+		{
+			os<<w;
+		}
+
+		static std::string toString(WordType w)
+		{
+			std::ostringstream os;
+			print(os,w);
+			return os.str();
+		}
+	}; // class BitWord<unsigned long long>
+
+#ifdef __SIZEOF_INT128__
+	template<>
+	class BitWord<unsigned __int128> {
+
+		typedef unsigned __int128 WordType;
+		typedef unsigned long long HalfType;
+
+	public:
+
+		enum {BITS=128};
+
+		static size_t count(WordType w)
+		{
+			return BitWord<HalfType>::count(HalfType(w)) +
+			       BitWord<HalfType>::count(HalfType(w>>64));
+		}
+
+		static size_t parity(WordType w)
+		{
+			return BitWord<HalfType>::parity(HalfType(w) ^ HalfType(w>>64));
+		}
+
+		static size_t low(WordType w)
+		{
+			return size_t(w);
+		}
+
+		static WordType bit(size_t i)
+		{
+			return (i<size_t(BITS)) ? (WordType(1)<<i) : 0;
+		}
+
+		static WordType lowMask(size_t n)
+		{
+			return (n>=size_t(BITS)) ? ~WordType(0) : (WordType(1)<<n) - 1;
+		}
+
+		// in decimal, as for unsigned long long
+		static void print(std::ostream& os,WordType w)
+		{
+			std::string digits;
+			do {
+				digits += char('0' + int(w % 10));
+				w /= 10;
+			} while (w>0);
+			std::reverse(digits.begin(),digits.end());
+			os<<digits;
+		}
+
+		static std::string toString(WordType w)
+		{
+			std::ostringstream os;
+			print(os,w);
+			return os.str();
+		}
+	}; // class BitWord<unsigned __int128>
+#endif
+
+	template<size_t N>
+	class BitWord<MultiWord<N> > {
+
+		typedef MultiWord<N> WordType;
+		typedef typename WordType::LimbType LimbType;
+
+	public:
+
+		enum {BITS=N*WordType::LIMB_BITS};
+
+		static size_t count(const WordType& w)
+		{
+			size_t c = 0;
+			for (size_t i=0;i<N;i++) c += BitWord<LimbType>::count(w.word(i));
+			return c;
+		}
+
+		static size_t parity(const WordType& w)
+		{
+			LimbType all = 0;
+			for (size_t i=0;i<N;i++) all ^= w.word(i);
+			return BitWord<LimbType>::parity(all);
+		}
+
+		static size_t low(const WordType& w)
+		{
+			return size_t(w.word(0));
+		}
+
+		static WordType bit(size_t i)
+		{
+			WordType w;
+			if (i<size_t(BITS)) w.word(i/WordType::LIMB_BITS) = BitWord<LimbType>::bit(i%WordType::LIMB_BITS);
+			return w;
+		}
+
+		static WordType lowMask(size_t n)
+		{
+			WordType w;
+			for (size_t i=0;i<N;i++) {
+				size_t start = i*WordType::LIMB_BITS;
+				if (n>start) w.word(i) = BitWord<LimbType>::lowMask(n-start);
+			}
+			return w;
+		}
+
+		// in decimal, dividing all the words by 10 for each digit
+		static void print(std::ostream& os,WordType w)
+		{
+			std::string digits;
+			do {
+				LimbType rem = 0;
+				for (size_t i=N;i>0;i--) {
+					LimbType high = (rem<<32) | (w.word(i-1)>>32);
+					LimbType low = ((high%10)<<32) | (w.word(i-1) & 0xffffffffULL);
+					w.word(i-1) = ((high/10)<<32) | (low/10);
+					rem = low%10;
+				}
+				digits += char('0' + int(rem));
+			} while (w>0);
+			std::reverse(digits.begin(),digits.end());
+			os<<digits;
+		}
+
+		static std::string toString(const WordType& w)
+		{
+			std::ostringstream os;
+			print(os,w);
+			return os.str();
+		}
+	}; // class BitWord<MultiWord<N> >
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // BIT_WORD_H
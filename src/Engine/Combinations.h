@@ -0,0 +1,121 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file Combinations.h
+ *
+ *  All words of nsite bits with npart bits set, in increasing order,
+ *  so that the i-th word has rank i in the combinatorial number system:
+ *  sum of C(b,c) over its set bits, with b the position of the bit and
+ *  c the number of set bits up to it
+ *
+ *  fill() splits the words in threads blocks; each thread unranks the
+ *  first word of its block and goes on with Gosper's recurrence, see
+ *  Parallelizer.h
+ *
+ */
+#ifndef COMBINATIONS_H
+#define COMBINATIONS_H
+#include <vector>
+#include <cassert>
+#include "BitWord.h"
+#include "Binomial.h"
+#include "Parallelizer.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename WordType>
+	class Combinations {
+
+		typedef BitWord<WordType> BitWordType;
+
+		class FillHelper {
+
+		public:
+
+			FillHelper(std::vector<WordType>& data,size_t npart,const Binomial& comb)
+			: data_(data),npart_(npart),comb_(comb)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t total = data_.size();
+				size_t start = (total*threadNum)/threads;
+				size_t end = (total*(threadNum+1))/threads;
+				if (start==end) return;
+				WordType ket = unrank(start,npart_,comb_);
+				for (size_t i=start;i<end;i++) {
+					data_[i] = ket;
+					if (i+1<end) ket = next(ket);
+				}
+			}
+
+		private:
+
+			std::vector<WordType>& data_;
+			size_t npart_;
+			const Binomial& comb_;
+		}; // class FillHelper
+
+	public:
+
+		//! comb must go up to nsite
+		static void fill(std::vector<WordType>& data,
+		                 size_t nsite,
+		                 size_t npart,
+		                 const Binomial& comb,
+		                 size_t threads)
+		{
+			assert(comb.nmax()>=nsite);
+			data.resize((npart<=nsite) ? comb(nsite,npart) : 0);
+			FillHelper helper(data,npart,comb);
+			Parallelizer<FillHelper> parallelizer(threads);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! The word of rank index among those with npart bits set
+		static WordType unrank(size_t index,size_t npart,const Binomial& comb)
+		{
+			WordType ket = 0;
+			size_t b = comb.nmax();
+			for (size_t c=npart;c>0;c--) {
+				// the largest b with C(b,c)<=index
+				while (comb(b,c)>index) b--;
+				ket |= BitWordType::bit(b);
+				index -= comb(b,c);
+			}
+			return ket;
+		}
+
+		//! Gosper's recurrence: the next larger word with the same bits set
+		static WordType next(WordType ket)
+		{
+			size_t n = 0;
+			size_t m = 0;
+			for (;(ket&3)!=1;n++,ket>>=1)
+				m += BitWordType::low(ket&1);
+			return ((ket+1)<<n) ^ BitWordType::lowMask(m);
+		}
+	}; // class Combinations
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // COMBINATIONS_H
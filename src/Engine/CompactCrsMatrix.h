@@ -0,0 +1,355 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file CompactCrsMatrix.h
+ *
+ *  A CRS matrix that stores the off-diagonal values through a table
+ *
+ *  Off-diagonal entries of the Hamiltonians take only a few different
+ *  values (hoppings times a sign), so each entry keeps a 32-bit column
+ *  and an 8-bit (or 16-bit, if there are more than 256 values) index
+ *  into the table of values. The diagonal is kept as a plain vector.
+ *  This is 5 or 6 bytes per non-zero instead of the 12 or 16 bytes of
+ *  CrsMatrix, and the product, which is limited by memory bandwidth,
+ *  reads that much less
+ *
+ */
+#ifndef COMPACT_CRS_MATRIX_H
+#define COMPACT_CRS_MATRIX_H
+#include <vector>
+#include <map>
+#include <complex>
+#include <string>
+#include <cassert>
+#include <stdexcept>
+#include "CrsMatrix.h"
+#include "TypeToString.h"
+#include "Parallelizer.h"
+#include "RowPartition.h"
+#include "NumaPlacement.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename FieldType>
+	class CompactCrsMatrix {
+
+		typedef unsigned int ColumnType;
+		typedef unsigned char SmallCodeType;
+		typedef unsigned short LargeCodeType;
+
+		// exact comparison, equal values must share the same code
+		struct LessValue {
+
+			template<typename T>
+			bool operator()(const T& a,const T& b) const
+			{
+				return (a<b);
+			}
+
+			template<typename T>
+			bool operator()(const std::complex<T>& a,const std::complex<T>& b) const
+			{
+				if (std::real(a)!=std::real(b)) return (std::real(a)<std::real(b));
+				return (std::imag(a)<std::imag(b));
+			}
+		};
+
+		typedef std::map<FieldType,size_t,LessValue> MapType;
+
+	public:
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+
+	private:
+
+		template<typename SomeVectorType>
+		class MatrixVectorHelper {
+
+		public:
+
+			MatrixVectorHelper(SomeVectorType& x,
+			                   const SomeVectorType& y,
+			                   const CompactCrsMatrix& matrix)
+			: x_(x),y_(y),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t start = matrix_.partition_[threadNum];
+				size_t end = matrix_.partition_[threadNum+1];
+				if (matrix_.largeCodes_.size()==0)
+					matrix_.product(x_,y_,matrix_.smallCodes_,start,end);
+				else
+					matrix_.product(x_,y_,matrix_.largeCodes_,start,end);
+			}
+
+		private:
+
+			SomeVectorType& x_;
+			const SomeVectorType& y_;
+			const CompactCrsMatrix& matrix_;
+		}; // class MatrixVectorHelper
+
+		template<typename SomeVectorType>
+		class MatrixVectorBlockHelper {
+
+		public:
+
+			MatrixVectorBlockHelper(std::vector<SomeVectorType>& x,
+			                        const std::vector<SomeVectorType>& y,
+			                        const CompactCrsMatrix& matrix)
+			: x_(x),y_(y),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t start = matrix_.partition_[threadNum];
+				size_t end = matrix_.partition_[threadNum+1];
+				if (matrix_.largeCodes_.size()==0)
+					matrix_.productBlock(x_,y_,matrix_.smallCodes_,start,end);
+				else
+					matrix_.productBlock(x_,y_,matrix_.largeCodes_,start,end);
+			}
+
+		private:
+
+			std::vector<SomeVectorType>& x_;
+			const std::vector<SomeVectorType>& y_;
+			const CompactCrsMatrix& matrix_;
+		}; // class MatrixVectorBlockHelper
+
+		template<typename SomeVectorType,typename SomeRowOpType>
+		class MatrixVectorRowsHelper {
+
+		public:
+
+			MatrixVectorRowsHelper(const std::vector<SomeVectorType>& y,
+			                       SomeRowOpType& op,
+			                       const CompactCrsMatrix& matrix)
+			: y_(y),op_(op),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t start = matrix_.partition_[threadNum];
+				size_t end = matrix_.partition_[threadNum+1];
+				if (matrix_.largeCodes_.size()==0)
+					matrix_.productRows(y_,op_,matrix_.smallCodes_,start,end,threadNum);
+				else
+					matrix_.productRows(y_,op_,matrix_.largeCodes_,start,end,threadNum);
+			}
+
+		private:
+
+			const std::vector<SomeVectorType>& y_;
+			SomeRowOpType& op_;
+			const CompactCrsMatrix& matrix_;
+		}; // class MatrixVectorRowsHelper
+
+	public:
+
+		CompactCrsMatrix(size_t threads)
+		: threads_((threads==0) ? 1 : threads)
+		{}
+
+		void set(const SparseMatrixType& full)
+		{
+			size_t rows = full.row();
+			if (rows>size_t(ColumnType(-1))) {
+				std::string str("CompactCrsMatrix: rank " + ttos(rows));
+				str += " does not fit in 32-bit columns, use MatrixStorage=CRS\n";
+				throw std::runtime_error(str);
+			}
+
+			diag_.assign(rows,0);
+			rowPtr_.resize(rows+1);
+			columns_.clear();
+			values_.clear();
+			smallCodes_.clear();
+			largeCodes_.clear();
+			size_t nonZeros = (rows==0) ? 0 : full.getRowPtr(rows);
+			columns_.reserve(nonZeros);
+			largeCodes_.reserve(nonZeros);
+			MapType codeOfValue;
+			for (size_t i=0;i<rows;i++) {
+				rowPtr_[i] = columns_.size();
+				for (int k=full.getRowPtr(i);k<full.getRowPtr(i+1);k++) {
+					size_t col = full.getCol(k);
+					const FieldType& value = full.getValue(k);
+					if (col==i) {
+						diag_[i] += value;
+						continue;
+					}
+					typename MapType::iterator it = codeOfValue.find(value);
+					if (it==codeOfValue.end()) {
+						if (values_.size()>size_t(LargeCodeType(-1))) {
+							std::string str("CompactCrsMatrix: more than ");
+							str += ttos(values_.size()) + " different values,";
+							str += " use MatrixStorage=CRS\n";
+							throw std::runtime_error(str);
+						}
+						it = codeOfValue.insert(std::make_pair(value,values_.size())).first;
+						values_.push_back(value);
+					}
+					columns_.push_back(col);
+					largeCodes_.push_back(it->second);
+				}
+			}
+			rowPtr_[rows] = columns_.size();
+
+			if (values_.size()<=size_t(SmallCodeType(-1))+1) {
+				smallCodes_.assign(largeCodes_.begin(),largeCodes_.end());
+				std::vector<LargeCodeType>().swap(largeCodes_);
+			}
+
+			rowPartition(partition_,*this,rows,threads_);
+		}
+
+		size_t rank() const { return diag_.size(); }
+
+		size_t getRowPtr(size_t i) const { return rowPtr_[i]; }
+
+		//! Number of different off-diagonal values
+		size_t values() const { return values_.size(); }
+
+		//! Thread t computes rows [bounds[t],bounds[t+1])
+		void rowBounds(std::vector<size_t>& bounds) const { bounds = partition_; }
+
+		//! Puts the rows of each thread on its NUMA node, see NumaPlacement.h
+		void numaPlace() const
+		{
+			if (rank()==0) return;
+			NumaPlacement::place("CompactCRS.diagonal",&diag_[0],partition_);
+			std::vector<size_t> bounds(partition_);
+			bounds.back()++;
+			NumaPlacement::place("CompactCRS.rowPtr",&rowPtr_[0],bounds);
+			if (columns_.size()==0) return;
+			for (size_t t=0;t<bounds.size();t++) bounds[t] = rowPtr_[partition_[t]];
+			NumaPlacement::place("CompactCRS.columns",&columns_[0],bounds);
+			if (largeCodes_.size()==0)
+				NumaPlacement::place("CompactCRS.codes",&smallCodes_[0],bounds);
+			else
+				NumaPlacement::place("CompactCRS.codes",&largeCodes_[0],bounds);
+		}
+
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
+		{
+			assert(x.size()==rank() && y.size()==rank());
+			typedef MatrixVectorHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! x[v] += H y[v] for all v, reading H only once
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			typedef MatrixVectorBlockHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! Calls op(threadNum,v,i,(H y[v])_i) for each row i and vector v
+		template<typename SomeVectorType,typename SomeRowOpType>
+		void matrixVectorProductRows(const std::vector<SomeVectorType>& y,
+		                             SomeRowOpType& op) const
+		{
+			typedef MatrixVectorRowsHelper<SomeVectorType,SomeRowOpType> HelperType;
+			HelperType helper(y,op,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+	private:
+
+		template<typename SomeVectorType,typename SomeCodeVectorType>
+		void product(SomeVectorType& x,
+		             const SomeVectorType& y,
+		             const SomeCodeVectorType& codes,
+		             size_t start,
+		             size_t end) const
+		{
+			for (size_t i=start;i<end;i++) {
+				typename SomeVectorType::value_type sum = diag_[i]*y[i];
+				size_t kend = rowPtr_[i+1];
+				for (size_t k=rowPtr_[i];k<kend;k++)
+					sum += values_[codes[k]]*y[columns_[k]];
+				x[i] += sum;
+			}
+		}
+
+		template<typename SomeVectorType,typename SomeCodeVectorType>
+		void productBlock(std::vector<SomeVectorType>& x,
+		                  const std::vector<SomeVectorType>& y,
+		                  const SomeCodeVectorType& codes,
+		                  size_t start,
+		                  size_t end) const
+		{
+			for (size_t i=start;i<end;i++) {
+				size_t kend = rowPtr_[i+1];
+				for (size_t v=0;v<x.size();v++) {
+					const SomeVectorType& yv = y[v];
+					typename SomeVectorType::value_type sum = diag_[i]*yv[i];
+					for (size_t k=rowPtr_[i];k<kend;k++)
+						sum += values_[codes[k]]*yv[columns_[k]];
+					x[v][i] += sum;
+				}
+			}
+		}
+
+		template<typename SomeVectorType,typename SomeRowOpType,typename SomeCodeVectorType>
+		void productRows(const std::vector<SomeVectorType>& y,
+		                 SomeRowOpType& op,
+		                 const SomeCodeVectorType& codes,
+		                 size_t start,
+		                 size_t end,
+		                 size_t threadNum) const
+		{
+			for (size_t i=start;i<end;i++) {
+				size_t kend = rowPtr_[i+1];
+				for (size_t v=0;v<y.size();v++) {
+					const SomeVectorType& yv = y[v];
+					typename SomeVectorType::value_type sum = diag_[i]*yv[i];
+					for (size_t k=rowPtr_[i];k<kend;k++)
+						sum += values_[codes[k]]*yv[columns_[k]];
+					op(threadNum,v,i,sum);
+				}
+			}
+		}
+
+		size_t threads_;
+		std::vector<FieldType> diag_;
+		std::vector<size_t> rowPtr_;
+		std::vector<ColumnType> columns_;
+		std::vector<SmallCodeType> smallCodes_;
+		std::vector<LargeCodeType> largeCodes_;
+		std::vector<FieldType> values_;
+		std::vector<size_t> partition_;
+	}; // class CompactCrsMatrix
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // COMPACT_CRS_MATRIX_H
@@ -24,6 +24,8 @@ Please see full open source license included in file LICENSE.
 #include "ProgressIndicator.h"
 #include "CrsMatrix.h"
 #include "Vector.h"
+#include "MatrixStored.h"
+#include "ParametersEngine.h"
 
 namespace LanczosPlusPlus {
 
@@ -37,20 +39,28 @@ namespace LanczosPlusPlus {
 	public:
 
 		typedef PsimagLite::CrsMatrix<RealType> SparseMatrixType;
+		typedef MatrixStored<RealType> MatrixStoredType;
 		typedef std::vector<RealType> VectorType;
 
-		DefaultSymmetry(const BasisType& basis,const GeometryType& geometry)
+		DefaultSymmetry(const BasisType& basis,
+		                const GeometryType& geometry,
+		                const ParametersEngine<RealType>& params)
+		: matrixStored_(params.threads,params.matrixStorage),basis_(0)
 		{
 		}
 
 		template<typename SomeModelType>
 		void init(const SomeModelType& model,const BasisType& basis)
 		{
-			model.setupHamiltonian(matrixStored_,basis);
-//			std::cout<<matrixStored_;
+			// built already, for a symmetry reused from a SectorCache
+			if (basis_==&basis) return;
+			basis_ = &basis;
+			model.setupHamiltonian(matrixStored_.matrix(),basis,matrixStored_.threads(),matrixStored_.upperOnly());
+			matrixStored_.update();
+//			std::cout<<matrixStored_.matrix();
 		}
 
-		void transformMatrix(std::vector<SparseMatrixType>& matrix1,const SparseMatrixType& matrix) const
+		void transformMatrix(std::vector<MatrixStoredType>& matrix1,const SparseMatrixType& matrix) const
 		{
 			throw std::runtime_error("DefaultSymmetry: cannot call transformMatrix\n");
 		}
@@ -65,7 +75,7 @@ namespace LanczosPlusPlus {
 
 		std::string name() const { return "default"; }
 
-		size_t rank() const { return matrixStored_.row(); }
+		size_t rank() const { return matrixStored_.rank(); }
 
 		template<typename SomeVectorType>
 		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
@@ -73,9 +83,33 @@ namespace LanczosPlusPlus {
 			return matrixStored_.matrixVectorProduct(x,y);
 		}
 
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			return matrixStored_.matrixVectorProductBlock(x,y);
+		}
+
+		template<typename SomeVectorType,typename SomeRealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<SomeRealType>& a,
+		                      std::vector<SomeRealType>& b,
+		                      SomeRealType eps) const
+		{
+			return matrixStored_.lanczosStepBlock(x,y,a,b,eps);
+		}
+
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType& v) const
+		{
+			matrixStored_.numaPlace(v);
+		}
+
 	private:
 
-		SparseMatrixType matrixStored_;
+		MatrixStoredType matrixStored_;
+		const BasisType* basis_;
 
 	}; // class DefaultSymmetry
 } // namespace Dmrg
@@ -21,6 +21,7 @@ Please see full open source license included in file LICENSE.
 #ifndef ENGINE_H_
 #define ENGINE_H_
 #include <iostream>
+#include <sstream>
 #include "ProgressIndicator.h"
 #include "BLAS.h"
 #include "LanczosSolver.h"
@@ -29,6 +30,10 @@ Please see full open source license included in file LICENSE.
 #include "ParametersForSolver.h"
 #include "ParametersEngine.h"
 #include "DefaultSymmetry.h"
+#include "BatchedLanczos.h"
+#include "FusedLanczos.h"
+#include "NumaPlacement.h"
+#include "SectorCache.h"
 
 namespace LanczosPlusPlus {
 	template<typename ModelType_,
@@ -49,6 +54,7 @@ namespace LanczosPlusPlus {
 		typedef InternalProductTemplate<ModelType,SpecialSymmetryType> InternalProductType;
 		typedef DefaultSymmetry<typename ModelType::GeometryType,BasisType> DefaultSymmetryType;
 		typedef InternalProductTemplate<ModelType,DefaultSymmetryType> InternalProductDefaultType;
+		typedef SectorCache<ModelType,DefaultSymmetryType> SectorCacheType;
 
 		typedef PsimagLite::Random48<RealType> RandomType;
 		typedef PsimagLite::ParametersForSolver<RealType> ParametersForSolverType;
@@ -56,6 +62,7 @@ namespace LanczosPlusPlus {
 		                    LanczosSolverType;
 		typedef PsimagLite::LanczosSolver<ParametersForSolverType,InternalProductDefaultType,VectorType>
 							LanczosSolverDefaultType;
+		typedef FusedLanczos<InternalProductType,VectorType,RealType> FusedLanczosType;
 		typedef PsimagLite::Matrix<FieldType> MatrixType;
 		typedef typename LanczosSolverType::TridiagonalMatrixType
 				TridiagonalMatrixType;
@@ -69,9 +76,19 @@ namespace LanczosPlusPlus {
 		Engine(const ModelType& model,size_t numberOfSites,PsimagLite::IoSimple::In& io)
 		: model_(model),
 		  progress_("Engine",0),
-		  params_(io)
+		  params_(io),
+		  sectorCache_(model,params_,params_.sectorCache),
+		  symmetry_(model.basis(),model.geometry(),params_),
+		  defaultSymmetry_(model.basis(),model.geometry(),params_),
+		  modelSymmetry_(modelSymmetry(symmetry_,defaultSymmetry_))
 		{
 			// printHeader();
+			NumaPlacement::init(params_.numaPlacement);
+			if (NumaPlacement::mode()!=NumaPlacement::NUMA_NONE)
+				NumaPlacement::print(std::cout);
+			std::ostringstream msg;
+			msg<<"basis size="<<model_.size();
+			progress_.printline(msg,std::cout);
 			// task 1: Compute Hamiltonian and
 			// task 2: Compute ground state |phi>
 			computeGroundState();
@@ -92,53 +109,64 @@ namespace LanczosPlusPlus {
 							  const std::pair<size_t,size_t>& orbs) const
 		{
 			typedef typename ContinuedFractionCollectionType::ContinuedFractionType ContinuedFractionType;
-			typedef typename ModelType::BasisType BasisType;
-			const BasisType* basisNew = 0;
 
-			for (size_t type=0;type<4;type++) {
-				if (isite==jsite && type>1) continue;
-				//if (type&1) continue;
+			// types 0,2 and types 1,3 act on the same basis, so each pair shares
+			// one Hamiltonian and one batched Lanczos run
+			std::vector<ContinuedFractionType> cfs(4);
+			std::vector<bool> done(4,false);
+			for (size_t parity=0;parity<2;parity++) {
+				std::vector<size_t> types;
+				for (size_t type=parity;type<4;type+=2) {
+					if (isite==jsite && type>1) continue;
+					//if (type&1) continue;
+					types.push_back(type);
+				}
+
 				if (ProgramGlobals::needsNewBasis(what2)) {
 					std::pair<size_t,size_t> newParts(0,0);
-					if (!model_.hasNewParts(newParts,what2,type,spin,orbs)) continue;
-					// Create new bases
-					basisNew = new BasisType(model_.geometry(),newParts.first,newParts.second);
+					if (!model_.hasNewParts(newParts,what2,parity,spin,orbs)) continue;
+					typename SectorCacheType::Sector sector = sectorCache_(newParts);
+					spectralSector(cfs,what2,sector.basis(),sector.symmetry(),types,isite,jsite,spin);
 				} else {
-					basisNew = &model_.basis();
+					spectralSector(cfs,what2,model_.basis(),modelSymmetry_,types,isite,jsite,spin);
 				}
-				VectorType modifVector;
-				model_.getModifiedState(modifVector,what2,gsVector_,*basisNew,type,isite,jsite,spin);
-
-				DefaultSymmetryType symm(*basisNew,model_.geometry());
-				InternalProductTemplate<ModelType,DefaultSymmetryType> matrix(model_,*basisNew,symm);
-				ContinuedFractionType cf;
-
-				calcSpectral(cf,what2,modifVector,matrix,type,spin);
-				cfCollection.push(cf);
 
-				if (ProgramGlobals::needsNewBasis(what2)) delete basisNew;
+				for (size_t i=0;i<types.size();i++) done[types[i]] = true;
 			}
+
+			for (size_t type=0;type<4;type++)
+				if (done[type]) cfCollection.push(cfs[type]);
 		}
 
 		void twoPoint(PsimagLite::Matrix<typename VectorType::value_type>& result,size_t what2,size_t spin,const std::pair<size_t,size_t>& orbs) const
 		{
 			size_t type = 0;
 
-			const BasisType* basisNew = 0;
+			if (!ProgramGlobals::needsNewBasis(what2)) {
+				twoPoint(result,what2,spin,orbs,model_.basis());
+				return;
+			}
+
+			std::pair<size_t,size_t> newParts(0,0);
+			if (!model_.hasNewParts(newParts,ProgramGlobals::OPERATOR_C,type,spin,orbs)) return;
 
-			if (ProgramGlobals::needsNewBasis(what2)) {
-				std::pair<size_t,size_t> newParts(0,0);
-				if (!model_.hasNewParts(newParts,ProgramGlobals::OPERATOR_C,type,spin,orbs)) return;
+			typename SectorCacheType::Sector sector = sectorCache_(newParts);
 
-				basisNew = new BasisType(model_.geometry(),newParts.first,newParts.second);
+			std::cerr<<"basisNew.size="<<sector.basis().size()<<" ";
+			std::cerr<<"newparts.first="<<newParts.first<<" ";
+			std::cerr<<"newparts.second="<<newParts.second<<"\n";
 
-				std::cerr<<"basisNew.size="<<basisNew->size()<<" ";
-				std::cerr<<"newparts.first="<<newParts.first<<" ";
-				std::cerr<<"newparts.second="<<newParts.second<<"\n";
-			} else {
-				basisNew = &model_.basis();
-			}
+			twoPoint(result,what2,spin,orbs,sector.basis());
+		}
+
+	private:
 
+		void twoPoint(PsimagLite::Matrix<typename VectorType::value_type>& result,
+		              size_t what2,
+		              size_t spin,
+		              const std::pair<size_t,size_t>& orbs,
+		              const BasisType& basisNew) const
+		{
 			size_t total =result.n_row();
 
 			for (size_t isite=0;isite<total;isite++)
@@ -150,39 +178,32 @@ namespace LanczosPlusPlus {
 			typename VectorType::value_type sum = 0;
 			std::cout<<"orbs="<<orbs.first<<" "<<orbs.second<<"\n";
 			for (size_t isite=0;isite<total;isite++) {
-				VectorType modifVector1(basisNew->size(),0);
+				VectorType modifVector1(basisNew.size(),0);
 				if (orbs.first>=model_.orbitals(isite)) continue;
-				model_.accModifiedState(modifVector1,what2,*basisNew,gsVector_,BasisType::DESTRUCTOR,
+				model_.accModifiedState(modifVector1,what2,basisNew,gsVector_,BasisType::DESTRUCTOR,
 							isite,spin,orbs.first,isign);
 				for (size_t jsite=0;jsite<total;jsite++) {
-					VectorType modifVector2(basisNew->size(),0);
+					VectorType modifVector2(basisNew.size(),0);
 					if (orbs.second>=model_.orbitals(jsite)) continue;
-					model_.accModifiedState(modifVector2,what2,*basisNew,gsVector_,BasisType::DESTRUCTOR,
+					model_.accModifiedState(modifVector2,what2,basisNew,gsVector_,BasisType::DESTRUCTOR,
 								jsite,spin,orbs.second,isign);
 					result(isite,jsite) =  modifVector2*modifVector1;
 					if (isite==jsite) sum += result(isite,isite);
 				}
 			}
 			std::cout<<"Total Electrons = "<<sum<<"\n";
-
-			if (ProgramGlobals::needsNewBasis(what2)) delete basisNew;
 		}
 
-	private:
-
 		void computeGroundState()
 		{
-			SpecialSymmetryType rs(model_.basis(),model_.geometry());
+			SpecialSymmetryType& rs = symmetry_;
 			InternalProductType hamiltonian(model_,rs);
 			//if (CHECK_HERMICITY) checkHermicity(h);
 
-			ParametersForSolverType params;
-			params.steps =  ProgramGlobals::LanczosSteps;
-			params.tolerance = ProgramGlobals::LanczosTolerance;
-			params.lotaMemory = params_.storeLanczosVectors;
-			params.stepsForEnergyConvergence =ProgramGlobals::MaxLanczosSteps;
-
-			LanczosSolverType lanczosSolver(hamiltonian,params);
+			FusedLanczosType lanczosSolver(hamiltonian,
+			                               ProgramGlobals::LanczosSteps,
+			                               ProgramGlobals::LanczosTolerance,
+			                               params_.storeLanczosVectors);
 
 			gsEnergy_ = 1e10;
 			size_t offset = model_.basis().size();
@@ -204,42 +225,74 @@ namespace LanczosPlusPlus {
 			std::cout<<"#GSNorm="<<(gsVector_*gsVector_)<<"\n";
 		}
 
+		//! cfs[types[i]] for the types that act on basisNew, whose Hamiltonian is in symm
 		template<typename ContinuedFractionType>
-		void calcSpectral(ContinuedFractionType& cf,
+		void spectralSector(std::vector<ContinuedFractionType>& cfs,
+		                    size_t what2,
+		                    const BasisType& basisNew,
+		                    DefaultSymmetryType& symm,
+		                    const std::vector<size_t>& types,
+		                    int isite,
+		                    int jsite,
+		                    int spin) const
+		{
+			std::vector<VectorType> modifVectors(types.size());
+			for (size_t i=0;i<types.size();i++)
+				model_.getModifiedState(modifVectors[i],what2,gsVector_,basisNew,types[i],isite,jsite,spin);
+
+			InternalProductDefaultType matrix(model_,basisNew,symm);
+
+			calcSpectral(cfs,what2,modifVectors,matrix,types,spin);
+		}
+
+		//! cfs[types[i]] is the continued fraction of modifVectors[i]
+		template<typename ContinuedFractionType>
+		void calcSpectral(std::vector<ContinuedFractionType>& cfs,
 						  size_t what2,
-						  const VectorType& modifVector,
+						  const std::vector<VectorType>& modifVectors,
 						  const InternalProductDefaultType& matrix,
-						  size_t type,
+						  const std::vector<size_t>& types,
 						  size_t spin) const
 		{
 			typedef typename ContinuedFractionType::TridiagonalMatrixType
 			                                        TridiagonalMatrixType;
-			
+			typedef BatchedLanczos<InternalProductDefaultType,
+			                       VectorType,
+			                       TridiagonalMatrixType,
+			                       RealType> BatchedLanczosType;
 
 			RealType eps= ProgramGlobals::LanczosTolerance;
 			size_t iter= ProgramGlobals::LanczosSteps;
 
-			ParametersForSolverType params;
-			params.steps = iter;
-			params.tolerance = eps;
-			params.lotaMemory = params_.storeLanczosVectors;
-			params.stepsForEnergyConvergence =ProgramGlobals::MaxLanczosSteps;
-
-			LanczosSolverDefaultType lanczosSolver(matrix,params);
-
-			TridiagonalMatrixType ab;
+			BatchedLanczosType lanczos(matrix,iter,eps);
 
-			lanczosSolver.decomposition(modifVector,ab);
-			typename VectorType::value_type weight = modifVector*modifVector;
-			//weight = 1.0/weight;
-			int s = (type&1) ? -1 : 1;
-			double s2 = (type>1) ? -1 : 1;
-			if (!ProgramGlobals::isFermionic(what2)) s2 *= s;
-			//for (size_t i=0;i<ab.size();i++) ab.a(i) *= s;
-			cf.set(ab,gsEnergy_,std::real(weight*s2),s);
+			std::vector<TridiagonalMatrixType> ab;
 
+			lanczos.decomposition(modifVectors,ab);
+			for (size_t i=0;i<types.size();i++) {
+				size_t type = types[i];
+				typename VectorType::value_type weight = modifVectors[i]*modifVectors[i];
+				//weight = 1.0/weight;
+				int s = (type&1) ? -1 : 1;
+				double s2 = (type>1) ? -1 : 1;
+				if (!ProgramGlobals::isFermionic(what2)) s2 *= s;
+				//for (size_t i=0;i<ab.size();i++) ab.a(i) *= s;
+				cfs[type].set(ab[i],gsEnergy_,std::real(weight*s2),s);
+			}
 		}
 		
+		//! The ground state Hamiltonian serves the spectral functions if it is in the whole basis
+		static DefaultSymmetryType& modelSymmetry(DefaultSymmetryType& symmetry,DefaultSymmetryType&)
+		{
+			return symmetry;
+		}
+
+		template<typename SomeSymmetryType>
+		static DefaultSymmetryType& modelSymmetry(SomeSymmetryType&,DefaultSymmetryType& other)
+		{
+			return other;
+		}
+
 		//! For debugging purpose only:
 		void fullDiag(MatrixType& fm) const
 		{
@@ -252,6 +305,15 @@ namespace LanczosPlusPlus {
 		const ModelType& model_;
 		PsimagLite::ProgressIndicator progress_;
 		ParametersEngine<RealType> params_;
+		mutable SectorCacheType sectorCache_;
+		// the sectors of the ground state, kept after computeGroundState
+		SpecialSymmetryType symmetry_;
+		// Hamiltonian in the basis of the ground state for the spectral
+		// functions that keep the number of electrons: symmetry_ itself
+		// if it is a DefaultSymmetry, else defaultSymmetry_, built by the
+		// first of them
+		DefaultSymmetryType defaultSymmetry_;
+		DefaultSymmetryType& modelSymmetry_;
 		RealType gsEnergy_;
 		VectorType gsVector_; 
 	}; // class ContinuedFraction
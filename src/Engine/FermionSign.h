@@ -0,0 +1,203 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file FermionSign.h
+ *
+ *  Fermion signs and bit gathering shared by all bases. A sign is the
+ *  parity of the electrons of a ket under a mask of consecutive bits,
+ *  so it takes one mask and one popcount, with no loop over sites
+ *
+ *  extract() and deposit() gather the bits of a ket under a mask into
+ *  the low bits of a word, and back; the bases use them to split a ket
+ *  into its orbitals. On x86 they use pext and pdep, compiled with a
+ *  target attribute, if fermionSignBmi2() says the cpu has them; there
+ *  is a portable loop otherwise. Define FERMION_NO_BMI2 to build only
+ *  the loop (pext and pdep are microcoded, and slow, on AMD cpus before
+ *  Zen 3). Words wider than 64 bits go through them 64 bits at a time
+ *
+ */
+#ifndef FERMION_SIGN_H
+#define FERMION_SIGN_H
+#include "BitWord.h"
+
+#if !defined(FERMION_NO_BMI2) && defined(__GNUC__) && defined(__x86_64__)
+#define FERMION_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace LanczosPlusPlus {
+
+	inline bool fermionSignBmi2()
+	{
+#ifdef FERMION_X86_KERNELS
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("bmi2");
+#else
+		return false;
+#endif
+	}
+
+#ifdef FERMION_X86_KERNELS
+	__attribute__((target("bmi2")))
+	inline unsigned long long fermionExtractBmi2(unsigned long long w,unsigned long long mask)
+	{
+		return _pext_u64(w,mask);
+	}
+
+	__attribute__((target("bmi2")))
+	inline unsigned long long fermionDepositBmi2(unsigned long long w,unsigned long long mask)
+	{
+		return _pdep_u64(w,mask);
+	}
+#endif
+
+	//! The bits of w under mask, packed into the lowest bits
+	inline unsigned long long fermionExtract(unsigned long long w,unsigned long long mask,bool bmi2)
+	{
+#ifdef FERMION_X86_KERNELS
+		if (bmi2) return fermionExtractBmi2(w,mask);
+#endif
+		unsigned long long res = 0;
+		for (unsigned long long b=1;mask;mask&=mask-1,b<<=1)
+			if (w & mask & (~mask+1)) res |= b;
+		return res;
+	}
+
+	//! The lowest bits of w, spread over the bits of mask
+	inline unsigned long long fermionDeposit(unsigned long long w,unsigned long long mask,bool bmi2)
+	{
+#ifdef FERMION_X86_KERNELS
+		if (bmi2) return fermionDepositBmi2(w,mask);
+#endif
+		unsigned long long res = 0;
+		for (;mask;mask&=mask-1,w>>=1)
+			if (w & 1) res |= (mask & (~mask+1));
+		return res;
+	}
+
+#ifdef __SIZEOF_INT128__
+	// one half at a time
+	inline unsigned __int128 fermionExtract(unsigned __int128 w,unsigned __int128 mask,bool bmi2)
+	{
+		typedef unsigned long long HalfType;
+		unsigned __int128 low = fermionExtract(HalfType(w),HalfType(mask),bmi2);
+		unsigned __int128 high = fermionExtract(HalfType(w>>64),HalfType(mask>>64),bmi2);
+		return low | (high<<BitWord<HalfType>::count(HalfType(mask)));
+	}
+
+	inline unsigned __int128 fermionDeposit(unsigned __int128 w,unsigned __int128 mask,bool bmi2)
+	{
+		typedef unsigned long long HalfType;
+		size_t lowBits = BitWord<HalfType>::count(HalfType(mask));
+		unsigned __int128 low = fermionDeposit(HalfType(w),HalfType(mask),bmi2);
+		unsigned __int128 high = fermionDeposit(HalfType(w>>lowBits),HalfType(mask>>64),bmi2);
+		return low | (high<<64);
+	}
+#endif
+
+	// one word of 64 bits at a time, the lowest first
+	template<size_t N>
+	inline MultiWord<N> fermionExtract(const MultiWord<N>& w,const MultiWord<N>& mask,bool bmi2)
+	{
+		typedef typename MultiWord<N>::LimbType LimbType;
+		MultiWord<N> res;
+		size_t shift = 0;
+		for (size_t i=0;i<N;i++) {
+			LimbType bits = fermionExtract(w.word(i),mask.word(i),bmi2);
+			res |= (MultiWord<N>(bits)<<shift);
+			shift += BitWord<LimbType>::count(mask.word(i));
+		}
+		return res;
+	}
+
+	template<size_t N>
+	inline MultiWord<N> fermionDeposit(const MultiWord<N>& w,const MultiWord<N>& mask,bool bmi2)
+	{
+		typedef typename MultiWord<N>::LimbType LimbType;
+		MultiWord<N> res;
+		size_t shift = 0;
+		for (size_t i=0;i<N;i++) {
+			res.word(i) = fermionDeposit((w>>shift).word(0),mask.word(i),bmi2);
+			shift += BitWord<LimbType>::count(mask.word(i));
+		}
+		return res;
+	}
+
+	template<typename WordType>
+	class FermionSign {
+
+		typedef BitWord<WordType> BitWordType;
+
+	public:
+
+		//! Bits from, from+1, ..., upto-1; none if upto<=from
+		static WordType rangeMask(size_t from,size_t upto)
+		{
+			return BitWordType::lowMask(upto) & ~BitWordType::lowMask(from);
+		}
+
+		//! -1 if w has an odd number of bits set, 1 otherwise
+		static int sign(WordType w)
+		{
+			return 1 - 2*int(BitWordType::parity(w));
+		}
+
+		//! Sign of the electrons of ket in [from,upto)
+		static int signBetween(WordType ket,size_t from,size_t upto)
+		{
+			return sign(ket & rangeMask(from,upto));
+		}
+
+		/* Sign of moving an electron from orbital orb1 of site i to
+		 * orbital orb2 of site j>=i, with bit site*orbitals+orb for each
+		 * orbital: the electrons of ket after (i,orb1) in site i, in the
+		 * sites between i and j, and before (j,orb2) in site j. The
+		 * masks are xor'ed, so that for i==j a bit counted twice
+		 * cancels, as a sum of the three counts would
+		 */
+		static int hopSign(WordType ket,
+		                   size_t i,
+		                   size_t orb1,
+		                   size_t j,
+		                   size_t orb2,
+		                   size_t orbitals)
+		{
+			WordType mask = rangeMask((i+1)*orbitals,j*orbitals) ^
+			                rangeMask(i*orbitals+orb1,(i+1)*orbitals) ^
+			                rangeMask(j*orbitals,j*orbitals+orb2);
+			return sign(ket & mask);
+		}
+
+		static WordType extract(WordType ket,WordType mask,bool bmi2)
+		{
+			return fermionExtract(ket,mask,bmi2);
+		}
+
+		static WordType deposit(WordType bits,WordType mask,bool bmi2)
+		{
+			return fermionDeposit(bits,mask,bmi2);
+		}
+	}; // class FermionSign
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // FERMION_SIGN_H
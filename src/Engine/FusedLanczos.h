@@ -0,0 +1,232 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file FusedLanczos.h
+ *
+ *  Ground state by the Lanczos method, with each step done by
+ *  lanczosStepBlock of the matrix, so that the recursion is done in
+ *  the same sweep as the product (see LanczosStep.h)
+ *
+ *  It stops after steps steps, when b is below eps, or when the lowest
+ *  eigenvalue of the tridiagonal matrix changes by less than eps. The
+ *  ground state is then sum_j c_j v_j, where c is the lowest eigenvector
+ *  of the tridiagonal matrix; the v_j are kept if storeVectors is true,
+ *  or else computed again from the same initial vector
+ *
+ */
+#ifndef FUSED_LANCZOS_H
+#define FUSED_LANCZOS_H
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include "Matrix.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename MatrixType,typename VectorType,typename RealType>
+	class FusedLanczos {
+
+		typedef typename VectorType::value_type FieldType;
+
+		enum {BISECTION_ITERATIONS=200};
+
+	public:
+
+		FusedLanczos(const MatrixType& matrix,size_t steps,RealType eps,bool storeVectors)
+		: matrix_(matrix),steps_(steps),eps_(eps),storeVectors_(storeVectors)
+		{}
+
+		//! Starts from a random vector
+		void computeGroundState(RealType& energy,VectorType& z) const
+		{
+			size_t n = matrix_.rank();
+			VectorType initVector(n);
+			unsigned short seed[3] = {0x330e,0xabcd,0x1234};
+			for (size_t i=0;i<n;i++) randomValue(initVector[i],seed);
+			computeGroundState(energy,z,initVector);
+		}
+
+		void computeGroundState(RealType& energy,
+		                        VectorType& z,
+		                        const VectorType& initVector) const
+		{
+			std::vector<RealType> a;
+			std::vector<RealType> b;
+			std::vector<VectorType> vectors;
+			run(a,b,(storeVectors_) ? &vectors : 0,initVector,0,0);
+			size_t m = a.size();
+			if (m==0) throw std::runtime_error("FusedLanczos: zero initial vector\n");
+
+			PsimagLite::Matrix<RealType> t(m,m);
+			for (size_t j=0;j<m;j++) {
+				t(j,j) = a[j];
+				if (j+1==m) continue;
+				t(j,j+1) = t(j+1,j) = b[j];
+			}
+			std::vector<RealType> eigs(m);
+			diag(t,eigs,'V');
+			energy = eigs[0];
+			std::vector<RealType> c(m);
+			for (size_t j=0;j<m;j++) c[j] = t(j,0);
+
+			z.resize(initVector.size());
+			for (size_t i=0;i<z.size();i++) z[i] = 0;
+			if (storeVectors_) {
+				for (size_t j=0;j<m;j++)
+					for (size_t i=0;i<z.size();i++) z[i] += c[j]*vectors[j][i];
+				return;
+			}
+			std::vector<RealType> a2;
+			std::vector<RealType> b2;
+			run(a2,b2,0,initVector,&c,&z);
+		}
+
+	private:
+
+		/* The recursion from initVector. If vectors is not null it gets all
+		 * the Lanczos vectors. If c is not null it runs c->size() steps and
+		 * adds c_j v_j to z instead of checking convergence
+		 */
+		void run(std::vector<RealType>& a,
+		         std::vector<RealType>& b,
+		         std::vector<VectorType>* vectors,
+		         const VectorType& initVector,
+		         const std::vector<RealType>* c,
+		         VectorType* z) const
+		{
+			size_t n = initVector.size();
+			RealType norm = std::sqrt(dot(initVector,initVector));
+			if (norm==0) return;
+
+			// block of one vector, see LanczosStep.h
+			std::vector<VectorType> x(1,VectorType(n,0));
+			std::vector<VectorType> y(1,initVector);
+			for (size_t i=0;i<n;i++) y[0][i] /= norm;
+			matrix_.numaPlace(x[0]);
+			matrix_.numaPlace(y[0]);
+			std::vector<RealType> aStep;
+			std::vector<RealType> bStep(1,0);
+
+			size_t steps = (c) ? c->size() : std::min(steps_,n);
+			RealType energy = 0;
+			for (size_t j=0;j<steps;j++) {
+				if (vectors) vectors->push_back(y[0]);
+				if (c) {
+					for (size_t i=0;i<n;i++) (*z)[i] += (*c)[j]*y[0][i];
+					// the next vector is not needed after the last one
+					if (j+1==steps) break;
+				}
+
+				matrix_.lanczosStepBlock(x,y,aStep,bStep,eps_);
+				a.push_back(aStep[0]);
+				b.push_back(bStep[0]);
+				if (c) continue;
+
+				if (bStep[0]<eps_) break;
+				RealType energyOld = energy;
+				energy = lowestEigenvalue(a,b);
+				if (j>0 && std::fabs(energy-energyOld)<eps_) break;
+			}
+		}
+
+		// by bisection with Sturm sequences; b[j] joins a[j] and a[j+1]
+		static RealType lowestEigenvalue(const std::vector<RealType>& a,
+		                                 const std::vector<RealType>& b)
+		{
+			size_t m = a.size();
+			RealType low = a[0];
+			RealType high = a[0];
+			for (size_t j=0;j<m;j++) {
+				RealType radius = 0;
+				if (j>0) radius += std::fabs(b[j-1]);
+				if (j+1<m) radius += std::fabs(b[j]);
+				low = std::min(low,a[j]-radius);
+				high = std::max(high,a[j]+radius);
+			}
+
+			for (size_t iter=0;iter<BISECTION_ITERATIONS;iter++) {
+				RealType middle = 0.5*(low+high);
+				if (middle<=low || middle>=high) break;
+				if (eigenvaluesBelow(a,b,middle)>0)
+					high = middle;
+				else
+					low = middle;
+			}
+			return 0.5*(low+high);
+		}
+
+		static size_t eigenvaluesBelow(const std::vector<RealType>& a,
+		                               const std::vector<RealType>& b,
+		                               RealType x)
+		{
+			size_t count = 0;
+			RealType q = 1;
+			for (size_t j=0;j<a.size();j++) {
+				RealType b2 = (j==0) ? 0 : b[j-1]*b[j-1];
+				if (q==0) q = 1e-300;
+				q = a[j] - x - b2/q;
+				if (q<0) count++;
+			}
+			return count;
+		}
+
+		static RealType dot(const VectorType& v,const VectorType& w)
+		{
+			RealType sum = 0;
+			for (size_t i=0;i<v.size();i++) sum += realOfProduct(v[i],w[i]);
+			return sum;
+		}
+
+		static RealType realOfProduct(const RealType& v,const RealType& w)
+		{
+			return v*w;
+		}
+
+		static RealType realOfProduct(const std::complex<RealType>& v,
+		                              const std::complex<RealType>& w)
+		{
+			return std::real(std::conj(v)*w);
+		}
+
+		static void randomValue(RealType& value,unsigned short* seed)
+		{
+			value = erand48(seed) - 0.5;
+		}
+
+		static void randomValue(std::complex<RealType>& value,unsigned short* seed)
+		{
+			RealType re = erand48(seed) - 0.5;
+			value = std::complex<RealType>(re,erand48(seed) - 0.5);
+		}
+
+		const MatrixType& matrix_;
+		size_t steps_;
+		RealType eps_;
+		bool storeVectors_;
+	}; // class FusedLanczos
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // FUSED_LANCZOS_H
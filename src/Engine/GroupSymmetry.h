@@ -0,0 +1,553 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file GroupSymmetry.h
+ *
+ *  The abelian group generated by some of: the translation by one site
+ *  along each direction in TranslationDirections (UseTranslationSymmetry=1),
+ *  the reflection of the Geometry (UseReflectionSymmetry=1), and the
+ *  exchange of the up and down words (UseSpinFlipSymmetry=1), selected
+ *  with UseGroupSymmetry=1 in the input. TranslationSymmetry.h and
+ *  SpinFlipSymmetry.h are this class with fixed generators
+ *
+ *  Each generator is a permutation of the sites, from the Geometry, or
+ *  the spin flip; its order n is that of the permutation. Element g has
+ *  exponent g_j of generator j, with g = g_0 + n_0*(g_1 + n_1*(...)),
+ *  and so does sector s, whose character is
+ *  chi_s(g) = exp(2 pi i sum_j s_j g_j/n_j)
+ *  Generators that do not commute are an error: the reflection and the
+ *  translations of a ring do not, so they cannot be used together.
+ *  With a real FieldType all generators must have order 2 or less, so
+ *  that the characters are real
+ *
+ *  Elements act with the sign of reordering the fermions: each word is
+ *  one block of operators ordered by site, with the up block before the
+ *  down block, as in the Hubbard and t-J bases. Each state is the
+ *  smallest state of its orbit, its representative r, acted on by some
+ *  element g, with sign e; row a of sector s is the state
+ *  sum over its orbit of chi_s(g) e |g r>/sqrt(d)
+ *  for the representatives whose stabilizer has chi_s(h) e = 1. The
+ *  sectors are built directly, see SymmetryBlockBuilder.h, and no
+ *  transform is stored: the ground state goes back to the basis with
+ *  the orbit and element of each state
+ *
+ */
+#ifndef GROUP_SYMM_H
+#define GROUP_SYMM_H
+#include <iostream>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include "ProgressIndicator.h"
+#include "CrsMatrix.h"
+#include "TypeToString.h"
+#include "Vector.h"
+#include "MatrixStored.h"
+#include "BitWord.h"
+#include "Parallelizer.h"
+#include "ParametersEngine.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename GeometryType,
+	         typename BasisType,
+	         typename FieldType=std::complex<typename GeometryType::RealType> >
+	class GroupSymmetry  {
+
+		typedef typename GeometryType::RealType RealType;
+		typedef std::complex<RealType> ComplexType;
+		typedef typename BasisType::WordType WordType;
+		typedef BitWord<WordType> BitWordType;
+
+		// a state is sign times element acting on the representative of orbit
+		struct Item {
+			size_t orbit;
+			size_t element;
+			int sign;
+		};
+
+		/* next[j][state] is generator j acting on state, times
+		 * sign[j][state], for the states of block threadNum
+		 */
+		class NextHelper {
+
+		public:
+
+			NextHelper(const GroupSymmetry& symmetry,
+			           std::vector<std::vector<size_t> >& next,
+			           std::vector<std::vector<int> >& sign)
+			: symmetry_(symmetry),next_(next),sign_(sign)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t total = symmetry_.basis_.size();
+				size_t start = (total*threadNum)/threads;
+				size_t end = (total*(threadNum+1))/threads;
+				// the words of one state, allocated once per thread
+				std::vector<WordType> kets(symmetry_.basis_.dofs());
+				for (size_t j=0;j<next_.size();j++) {
+					for (size_t ispace=start;ispace<end;ispace++) {
+						int sign = 1;
+						next_[j][ispace] = symmetry_.act(j,ispace,sign,kets);
+						sign_[j][ispace] = sign;
+					}
+				}
+			}
+
+		private:
+
+			const GroupSymmetry& symmetry_;
+			std::vector<std::vector<size_t> >& next_;
+			std::vector<std::vector<int> >& sign_;
+		}; // class NextHelper
+
+	public:
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+		typedef MatrixStored<FieldType> MatrixStoredType;
+		typedef std::vector<FieldType> VectorType;
+
+		// the rows of one sector, see SymmetryBlockBuilder.h
+		class Sector {
+
+		public:
+
+			Sector(const GroupSymmetry& symmetry,size_t s)
+			: symmetry_(symmetry),
+			  row_(symmetry.reps_.size(),none()),
+			  character_(symmetry.elements())
+			{
+				for (size_t g=0;g<character_.size();g++)
+					character_[g] = symmetry.character(s,g);
+				for (size_t i=0;i<symmetry.reps_.size();i++) {
+					if (!symmetry.hasSector(i,character_)) continue;
+					row_[i] = orbits_.size();
+					orbits_.push_back(i);
+				}
+			}
+
+			size_t size() const { return orbits_.size(); }
+
+			size_t state(size_t a) const { return symmetry_.reps_[orbits_[a]]; }
+
+			RealType weight(size_t a) const
+			{
+				return sqrt(RealType(symmetry_.orbitSize(orbits_[a])));
+			}
+
+			bool column(size_t t,size_t& b,FieldType& value) const
+			{
+				const Item& item = symmetry_.data_[t];
+				b = row_[item.orbit];
+				if (b==none()) return false;
+				RealType norm = item.sign/sqrt(RealType(symmetry_.orbitSize(item.orbit)));
+				convert(value,std::conj(character_[item.element])*norm);
+				return true;
+			}
+
+		private:
+
+			static size_t none() { return size_t(-1); }
+
+			const GroupSymmetry& symmetry_;
+			std::vector<size_t> row_;
+			std::vector<size_t> orbits_;
+			std::vector<ComplexType> character_;
+		}; // class Sector
+
+		typedef Sector SectorType;
+
+		//! The generators that params selects, see the top of this file
+		GroupSymmetry(const BasisType& basis,
+		              const GeometryType& geometry,
+		              const ParametersEngine<RealType>& params)
+		: progress_("GroupSymmetry",0),
+		  basis_(basis),
+		  data_(basis.size()),
+		  orbitOffset_(1,0),
+		  stabilizerOffset_(1,0),
+		  threads_(params.threads),
+		  storage_(params.matrixStorage),
+		  caller_("GroupSymmetry"),
+		  pointer_(0)
+		{
+			std::vector<size_t> directions;
+			if (params.useTranslationSymmetry) directions = params.translationDirections;
+			setGenerators(geometry,directions,params.useReflectionSymmetry,params.useSpinFlipSymmetry);
+		}
+
+		//! The translations along directions, the reflection and the spin flip if given; caller names the errors
+		GroupSymmetry(const BasisType& basis,
+		              const GeometryType& geometry,
+		              const ParametersEngine<RealType>& params,
+		              const std::vector<size_t>& directions,
+		              bool reflection,
+		              bool spinFlip,
+		              const std::string& caller)
+		: progress_(caller,0),
+		  basis_(basis),
+		  data_(basis.size()),
+		  orbitOffset_(1,0),
+		  stabilizerOffset_(1,0),
+		  threads_(params.threads),
+		  storage_(params.matrixStorage),
+		  caller_(caller),
+		  pointer_(0)
+		{
+			setGenerators(geometry,directions,reflection,spinFlip);
+		}
+
+		//! Builds each sector directly, see SymmetryBlockBuilder.h
+		template<typename SomeModelType>
+		void init(const SomeModelType& model,const BasisType& basis)
+		{
+			model.setupHamiltonian(matrixStored_,basis,*this,threads_);
+		}
+
+		size_t rank() const { return matrixStored_[pointer_].rank(); }
+
+		//! gs is in the sector whose rows start at offset, as counted by Engine
+		void transformGs(VectorType& gs,size_t offset)
+		{
+			size_t s = 0;
+			size_t start = 0;
+			for (;s<elements();s++) {
+				if (start==offset && sectorSize_[s]==gs.size() && gs.size()>0) break;
+				start += sectorSize_[s];
+			}
+			if (s==elements())
+				throw std::runtime_error("GroupSymmetry: no sector for the ground state\n");
+
+			SectorType sector(*this,s);
+			VectorType gstmp(basis_.size(),0);
+			size_t b = 0;
+			FieldType value = 0;
+			for (size_t t=0;t<gstmp.size();t++) {
+				if (!sector.column(t,b,value)) continue;
+				gstmp[t] = value*gs[b];
+			}
+			gs.swap(gstmp);
+		}
+
+		size_t sectors() const { return elements(); }
+
+		SectorType sector(size_t s) const
+		{
+			return SectorType(*this,s);
+		}
+
+		void setPointer(size_t p) { pointer_=p; }
+
+		std::string name() const { return "group"; }
+
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
+		{
+			return matrixStored_[pointer_].matrixVectorProduct(x,y);
+		}
+
+		template<typename SomeVectorType,typename SomeRealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<SomeRealType>& a,
+		                      std::vector<SomeRealType>& b,
+		                      SomeRealType eps) const
+		{
+			return matrixStored_[pointer_].lanczosStepBlock(x,y,a,b,eps);
+		}
+
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType& v) const
+		{
+			matrixStored_[pointer_].numaPlace(v);
+		}
+
+	private:
+
+		void setGenerators(const GeometryType& geometry,
+		                   const std::vector<size_t>& directions,
+		                   bool reflection,
+		                   bool spinFlip)
+		{
+			std::ostringstream msg;
+			size_t nsites = geometry.numberOfSites();
+			size_t termId = 0;
+			for (size_t i=0;i<directions.size();i++) {
+				size_t dir = directions[i];
+				std::vector<size_t> perm(nsites);
+				for (size_t site=0;site<nsites;site++)
+					perm[site] = geometry.translate(site,dir,1,termId);
+				addGenerator(perm,false);
+				msg<<"translation("<<dir<<") ";
+			}
+			if (reflection) {
+				std::vector<size_t> perm(nsites);
+				for (size_t site=0;site<nsites;site++)
+					perm[site] = geometry.findReflection(site,termId);
+				addGenerator(perm,false);
+				msg<<"reflection ";
+			}
+			if (spinFlip) {
+				if (basis_.dofs()!=2)
+					throw std::runtime_error(caller_ + ": spin flip needs one orbital per site\n");
+				std::vector<size_t> perm(nsites);
+				for (size_t site=0;site<nsites;site++) perm[site] = site;
+				addGenerator(perm,true);
+				msg<<"spinflip ";
+			}
+			checkCommute();
+			if (isReal(static_cast<FieldType*>(0))) {
+				for (size_t j=0;j<orders_.size();j++) {
+					if (orders_[j]<=2) continue;
+					throw std::runtime_error(caller_ + ": generator " + ttos(j) +
+					                         " has complex characters\n");
+				}
+			}
+			msg<<"order "<<elements();
+			progress_.printline(msg,std::cout);
+
+			setOrbits();
+			matrixStored_.resize(elements(),MatrixStoredType(threads_,storage_));
+		}
+
+		// adds perm, or the spin flip, with the order of perm, or 2
+		void addGenerator(const std::vector<size_t>& perm,bool flip)
+		{
+			size_t n = perm.size();
+			std::vector<bool> seen(n,false);
+			size_t order = 1;
+			for (size_t site=0;site<n;site++) {
+				if (seen[site]) continue;
+				size_t cycle = 0;
+				for (size_t x=site;!seen[x];x=perm[x]) {
+					if (x>=n) throw std::runtime_error(caller_ + ": site out of range\n");
+					seen[x] = true;
+					cycle++;
+				}
+				if (perm[site]>=n || !seen[perm[site]])
+					throw std::runtime_error(caller_ + ": generator is not a permutation\n");
+				order = lcm(order,cycle);
+			}
+			if (flip) order = 2;
+			perms_.push_back(perm);
+			flips_.push_back(flip);
+			orders_.push_back(order);
+		}
+
+		void checkCommute() const
+		{
+			for (size_t i=0;i<perms_.size();i++) {
+				for (size_t j=i+1;j<perms_.size();j++) {
+					const std::vector<size_t>& a = perms_[i];
+					const std::vector<size_t>& b = perms_[j];
+					for (size_t site=0;site<a.size();site++) {
+						if (a[b[site]]==b[a[site]]) continue;
+						std::string str(caller_ + ": generators " + ttos(i));
+						str += " and " + ttos(j) + " do not commute\n";
+						throw std::runtime_error(str);
+					}
+				}
+			}
+		}
+
+		/* Follows the orbit of each state not seen yet, which is then
+		 * its smallest state, under all elements, and keeps the elements
+		 * other than the identity that leave the representative as it
+		 * is, with their signs. Element g is generator j acting on
+		 * element g-stride_j, for the first j with g_j>0, so that each
+		 * element takes one read of the tables of the generators
+		 */
+		void setOrbits()
+		{
+			size_t hilbert = basis_.size();
+			if (hilbert>0 && hasSpinFlip() &&
+			    BitWordType::count(basis_(0,0))!=BitWordType::count(basis_(0,1)))
+				throw std::runtime_error(caller_ + ": spin flip needs as many electrons up as down\n");
+
+			std::vector<std::vector<size_t> > next(orders_.size(),std::vector<size_t>(hilbert));
+			std::vector<std::vector<int> > nextSign(orders_.size(),std::vector<int>(hilbert));
+			NextHelper helper(*this,next,nextSign);
+			Parallelizer<NextHelper> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+
+			size_t total = elements();
+			std::vector<size_t> state(total);
+			std::vector<int> sign(total);
+			std::vector<bool> seen(hilbert,false);
+			for (size_t ispace=0;ispace<hilbert;ispace++) {
+				if (seen[ispace]) continue;
+				size_t orbit = reps_.size();
+				reps_.push_back(ispace);
+				state[0] = ispace;
+				sign[0] = 1;
+				for (size_t g=0;g<total;g++) {
+					if (g>0) {
+						size_t j = 0;
+						size_t stride = 1;
+						for (;(g/stride) % orders_[j]==0;j++) stride *= orders_[j];
+						size_t prev = state[g-stride];
+						state[g] = next[j][prev];
+						sign[g] = sign[g-stride]*nextSign[j][prev];
+						if (state[g]==ispace)
+							stabilizer_.push_back(std::pair<size_t,int>(g,sign[g]));
+					}
+					if (seen[state[g]]) continue;
+					seen[state[g]] = true;
+					data_[state[g]].orbit = orbit;
+					data_[state[g]].element = g;
+					data_[state[g]].sign = sign[g];
+					orbits_.push_back(state[g]);
+				}
+				orbitOffset_.push_back(orbits_.size());
+				stabilizerOffset_.push_back(stabilizer_.size());
+			}
+
+			sectorSize_.resize(total,0);
+			size_t sum = 0;
+			for (size_t s=0;s<total;s++) {
+				std::vector<ComplexType> chi(total);
+				for (size_t g=0;g<total;g++) chi[g] = character(s,g);
+				for (size_t i=0;i<reps_.size();i++)
+					if (hasSector(i,chi)) sectorSize_[s]++;
+				sum += sectorSize_[s];
+			}
+			if (sum!=hilbert) {
+				std::string str(caller_ + ": sectors sum to " + ttos(sum));
+				str += " but hilbert=" + ttos(hilbert) + "\n";
+				throw std::runtime_error(str);
+			}
+		}
+
+		bool hasSpinFlip() const
+		{
+			for (size_t j=0;j<flips_.size();j++)
+				if (flips_[j]) return true;
+			return false;
+		}
+
+		size_t elements() const
+		{
+			size_t total = 1;
+			for (size_t j=0;j<orders_.size();j++) total *= orders_[j];
+			return total;
+		}
+
+		// the state that generator j makes of state ispace, times sign; y has dofs() words
+		size_t act(size_t j,size_t ispace,int& sign,std::vector<WordType>& y) const
+		{
+			size_t dofs = y.size();
+			for (size_t dof=0;dof<dofs;dof++)
+				y[dof] = permute(basis_(ispace,dof),perms_[j],sign);
+			if (flips_[j]) {
+				// the down block moves before the up block
+				if ((BitWordType::count(y[0])*BitWordType::count(y[1])) & 1) sign = -sign;
+				std::swap(y[0],y[1]);
+			}
+			return basis_.perfectIndex(y);
+		}
+
+		// moves the electron of each site to perm[site]; sign of putting them back in order
+		WordType permute(WordType x,const std::vector<size_t>& perm,int& sign) const
+		{
+			WordType y = 0;
+			size_t crossings = 0;
+			for (size_t site=0;x;site++,x>>=1) {
+				if (!(x & 1)) continue;
+				size_t p = perm[site];
+				crossings += BitWordType::count(y & ~BitWordType::lowMask(p+1));
+				y |= BitWordType::bit(p);
+			}
+			if (crossings & 1) sign = -sign;
+			return y;
+		}
+
+		ComplexType character(size_t s,size_t g) const
+		{
+			RealType phase = 0;
+			for (size_t j=0;j<orders_.size();j++) {
+				phase += RealType((s % orders_[j])*(g % orders_[j]))/orders_[j];
+				s /= orders_[j];
+				g /= orders_[j];
+			}
+			phase *= 2*M_PI;
+			return ComplexType(cos(phase),sin(phase));
+		}
+
+		size_t orbitSize(size_t i) const
+		{
+			return orbitOffset_[i+1] - orbitOffset_[i];
+		}
+
+		// the orbit of i has a state in the sector of chi if chi(h) e = 1 in its stabilizer
+		bool hasSector(size_t i,const std::vector<ComplexType>& chi) const
+		{
+			for (size_t k=stabilizerOffset_[i];k<stabilizerOffset_[i+1];k++) {
+				const std::pair<size_t,int>& h = stabilizer_[k];
+				if (std::norm(chi[h.first]*RealType(h.second) - 1.0)>1e-8) return false;
+			}
+			return true;
+		}
+
+		// the characters are real if all orders are 2 or less, see setGenerators
+		static void convert(RealType& value,const ComplexType& c) { value = std::real(c); }
+
+		static void convert(ComplexType& value,const ComplexType& c) { value = c; }
+
+		static bool isReal(const RealType*) { return true; }
+
+		static bool isReal(const ComplexType*) { return false; }
+
+		static size_t lcm(size_t a,size_t b)
+		{
+			size_t x = a;
+			size_t y = b;
+			while (y) {
+				size_t tmp = x % y;
+				x = y;
+				y = tmp;
+			}
+			return a/x*b;
+		}
+
+		PsimagLite::ProgressIndicator progress_;
+		const BasisType& basis_;
+		std::vector<size_t> orders_;
+		std::vector<std::vector<size_t> > perms_;
+		std::vector<bool> flips_;
+		std::vector<Item> data_;
+		std::vector<size_t> reps_;
+		std::vector<size_t> orbits_;
+		std::vector<size_t> orbitOffset_;
+		std::vector<std::pair<size_t,int> > stabilizer_;
+		std::vector<size_t> stabilizerOffset_;
+		std::vector<size_t> sectorSize_;
+		size_t threads_;
+		std::string storage_;
+		std::string caller_;
+		std::vector<MatrixStoredType> matrixStored_;
+		size_t pointer_;
+	}; // class GroupSymmetry
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // GROUP_SYMM_H
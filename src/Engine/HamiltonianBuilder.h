@@ -0,0 +1,200 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file HamiltonianBuilder.h
+ *
+ *  Builds the stored Hamiltonian of a model in two passes over the rows
+ *
+ *  The model provides
+ *  fillRow(SparseRowType& row,size_t ispace,const BasisType& basis,
+ *          const std::vector<RealType>& diag) const
+ *  which adds the entries of row ispace. The first pass counts the
+ *  non-zeros of each row, a prefix sum gives the row pointers, and the
+ *  second pass writes each row into its place in the already allocated
+ *  CRS arrays. Both passes split the rows among threads, and each thread
+ *  uses the same row buffer for all its rows in both passes, so that
+ *  building allocates only when a buffer first grows. With upperOnly
+ *  only the entries with column >= row are stored, for
+ *  MatrixStorage=SymmetricCRS, see MatrixStored.h
+ *
+ */
+#ifndef HAMILTONIAN_BUILDER_H
+#define HAMILTONIAN_BUILDER_H
+#include <vector>
+#include <cassert>
+#include "CrsMatrix.h"
+#include "Parallelizer.h"
+#include "SparseRowBuffer.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename ModelType>
+	class HamiltonianBuilder {
+
+	public:
+
+		typedef typename ModelType::RealType RealType;
+		typedef typename ModelType::BasisType BasisType;
+		typedef PsimagLite::CrsMatrix<RealType> SparseMatrixType;
+		typedef SparseRowBuffer<RealType> SparseRowType;
+
+	private:
+
+		class CountHelper {
+
+		public:
+
+			CountHelper(const HamiltonianBuilder& builder,
+			            std::vector<SparseRowType>& rows,
+			            std::vector<size_t>& nonZeros)
+			: builder_(builder),rows_(rows),nonZeros_(nonZeros)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				SparseRowType& sparseRow = rows_[threadNum];
+				size_t end = builder_.rowEnd(threadNum,threads);
+				for (size_t i=builder_.rowStart(threadNum,threads);i<end;i++) {
+					builder_.fillRow(sparseRow,i);
+					nonZeros_[i] = sparseRow.size() - builder_.skipped(sparseRow,i);
+				}
+			}
+
+		private:
+
+			const HamiltonianBuilder& builder_;
+			std::vector<SparseRowType>& rows_;
+			std::vector<size_t>& nonZeros_;
+		}; // class CountHelper
+
+		class FillHelper {
+
+		public:
+
+			FillHelper(const HamiltonianBuilder& builder,
+			           std::vector<SparseRowType>& rows,
+			           SparseMatrixType& matrix)
+			: builder_(builder),rows_(rows),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				SparseRowType& sparseRow = rows_[threadNum];
+				size_t end = builder_.rowEnd(threadNum,threads);
+				for (size_t i=builder_.rowStart(threadNum,threads);i<end;i++) {
+					builder_.fillRow(sparseRow,i);
+					size_t offset = matrix_.getRowPtr(i);
+					size_t skipped = builder_.skipped(sparseRow,i);
+					assert(offset+sparseRow.size()-skipped==size_t(matrix_.getRowPtr(i+1)));
+					for (size_t k=skipped;k<sparseRow.size();k++) {
+						matrix_.setCol(offset+k-skipped,sparseRow.col(k));
+						matrix_.setValues(offset+k-skipped,sparseRow.value(k));
+					}
+				}
+			}
+
+		private:
+
+			const HamiltonianBuilder& builder_;
+			std::vector<SparseRowType>& rows_;
+			SparseMatrixType& matrix_;
+		}; // class FillHelper
+
+	public:
+
+		HamiltonianBuilder(const ModelType& model,
+		                   const BasisType& basis,
+		                   const std::vector<RealType>& diag,
+		                   size_t threads,
+		                   bool upperOnly = false)
+		: model_(model),
+		  basis_(basis),
+		  diag_(diag),
+		  threads_((threads==0) ? 1 : threads),
+		  upperOnly_(upperOnly)
+		{}
+
+		void build(SparseMatrixType& matrix) const
+		{
+			size_t hilbert = basis_.size();
+			std::vector<size_t> nonZeros(hilbert,0);
+			std::vector<SparseRowType> rows(threads_);
+			for (size_t t=0;t<threads_;t++) rows[t].reserveColumns(hilbert);
+
+			CountHelper countHelper(*this,rows,nonZeros);
+			Parallelizer<CountHelper> countParallelizer(threads_);
+			countParallelizer.loopCreate(countHelper);
+
+			size_t total = 0;
+			for (size_t i=0;i<hilbert;i++) total += nonZeros[i];
+
+			matrix.resize(hilbert,hilbert,total);
+			size_t offset = 0;
+			for (size_t i=0;i<hilbert;i++) {
+				matrix.setRow(i,offset);
+				offset += nonZeros[i];
+			}
+			matrix.setRow(hilbert,offset);
+
+			FillHelper fillHelper(*this,rows,matrix);
+			Parallelizer<FillHelper> fillParallelizer(threads_);
+			fillParallelizer.loopCreate(fillHelper);
+		}
+
+	private:
+
+		void fillRow(SparseRowType& sparseRow,size_t ispace) const
+		{
+			sparseRow.clear();
+			model_.fillRow(sparseRow,ispace,basis_,diag_);
+			sparseRow.finalize();
+		}
+
+		// entries of row ispace below the diagonal, first in the row, not to be stored
+		size_t skipped(const SparseRowType& sparseRow,size_t ispace) const
+		{
+			if (!upperOnly_) return 0;
+			size_t k = 0;
+			while (k<sparseRow.size() && sparseRow.col(k)<ispace) k++;
+			return k;
+		}
+
+		size_t rowStart(size_t threadNum,size_t threads) const
+		{
+			return (basis_.size()*threadNum)/threads;
+		}
+
+		size_t rowEnd(size_t threadNum,size_t threads) const
+		{
+			return (basis_.size()*(threadNum+1))/threads;
+		}
+
+		const ModelType& model_;
+		const BasisType& basis_;
+		const std::vector<RealType>& diag_;
+		size_t threads_;
+		bool upperOnly_;
+	}; // class HamiltonianBuilder
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // HAMILTONIAN_BUILDER_H
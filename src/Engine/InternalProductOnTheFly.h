@@ -84,53 +84,92 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include <vector>
 #include <cassert>
+#include <stdexcept>
+#include <string>
+#include "LanczosStep.h"
 
 namespace LanczosPlusPlus {
-	template<typename ModelType,typename ReflectionSymmetryType_>
+	template<typename ModelType,typename SpecialSymmetryType_>
 	class InternalProductOnTheFly {
 
 	public:
 
-		typedef ReflectionSymmetryType_ ReflectionSymmetryType;
+		typedef SpecialSymmetryType_ SpecialSymmetryType;
 		typedef typename ModelType::BasisType BasisType;
 		typedef typename ModelType::SparseMatrixType SparseMatrixType;
 		typedef typename ModelType::RealType RealType;
+		typedef typename ModelType::OnTheFlyDataType OnTheFlyDataType;
 
 		InternalProductOnTheFly(const ModelType& model,
 					const BasisType& basis,
-					const ReflectionSymmetryType* rs=0)
-		: model_(model),basis_(&basis)
+					SpecialSymmetryType& rs)
+		: model_(model),rank_(basis.size())
 		{
-			//model.setupHamiltonian(matrixStored_,b1,b2);
+			checkSymmetry(rs);
+			model_.setupOnTheFly(data_,basis);
 		}
 
 		InternalProductOnTheFly(const ModelType& model,
-					const ReflectionSymmetryType* rs=0)
-		: model_(model),basis_(0)
+					SpecialSymmetryType& rs)
+		: model_(model),rank_(model.size())
 		{
-			//model.setupHamiltonian(matrixStored_);
+			checkSymmetry(rs);
+			model_.setupOnTheFly(data_,model.basis());
 		}
 
-		size_t rank() const { return model_.size(); }
+		size_t rank() const { return rank_; }
 
 		template<typename SomeVectorType>
 		void matrixVectorProduct(SomeVectorType &x,SomeVectorType const &y) const
 		{
-			if (basis_==0) {
-				model_.matrixVectorProduct(x,y);
-			} else {
-				model_.matrixVectorProduct(x,y,basis_);
-			}
+			model_.matrixVectorProduct(x,y,data_);
 		}
 
-		size_t reflectionSector() const { return 0; }
+		//! Nothing is stored, so this is one product per vector
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			for (size_t v=0;v<x.size();v++)
+				matrixVectorProduct(x[v],y[v]);
+		}
 
-		void reflectionSector(size_t p) {  }
+		//! One Lanczos step per vector; rows are not fused with the product here
+		template<typename SomeVectorType,typename SomeRealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<SomeRealType>& a,
+		                      std::vector<SomeRealType>& b,
+		                      SomeRealType eps) const
+		{
+			std::vector<size_t> bounds(2,0);
+			bounds[1] = rank();
+			LanczosStep<SomeVectorType,SomeRealType> step(x,y,a,b,bounds);
+			step.scalePrevious();
+			matrixVectorProductBlock(x,y);
+			step.sumRows();
+			step.finish(eps);
+		}
+
+		//! There are no rows of threads to follow
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType&) const {}
+
+		void specialSymmetrySector(size_t p) { assert(p==0); }
 
 	private:
 
+		void checkSymmetry(const SpecialSymmetryType& rs) const
+		{
+			if (rs.sectors()==1) return;
+			std::string s("InternalProductOnTheFly: symmetry ");
+			s += rs.name() + " is not supported\n";
+			throw std::runtime_error(s.c_str());
+		}
+
 		const ModelType& model_;
-		const BasisType* basis_;
+		size_t rank_;
+		OnTheFlyDataType data_; // built once, read by every product
 	}; // class InternalProductOnTheFly
 } // namespace LanczosPlusPlus
 
@@ -118,6 +118,32 @@ namespace LanczosPlusPlus {
 			rs_.matrixVectorProduct(x,y);
 		}
 
+		//! x[v] += H y[v] for all v, reading the stored H only once
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			rs_.matrixVectorProductBlock(x,y);
+		}
+
+		//! One Lanczos step per vector, fused with the product, see LanczosStep.h
+		template<typename SomeVectorType,typename SomeRealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<SomeRealType>& a,
+		                      std::vector<SomeRealType>& b,
+		                      SomeRealType eps) const
+		{
+			rs_.lanczosStepBlock(x,y,a,b,eps);
+		}
+
+		//! Call once for each Lanczos vector, when it is allocated
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType& v) const
+		{
+			rs_.numaPlace(v);
+		}
+
 		//size_t reflectionSector() const { return pointer_; }
 
 		void specialSymmetrySector(size_t p) { rs_.setPointer(p); }
@@ -0,0 +1,260 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file LanczosStep.h
+ *
+ *  One step of the Lanczos recursion for several vectors, with as few
+ *  passes over the vectors as possible
+ *
+ *  On entry y[v] is the current Lanczos vector and x[v] the previous one,
+ *  and b[v] the previous b. Each row i of H y[v], as soon as it is
+ *  computed, gives w = (H y[v])_i - b[v] x[v]_i, which is stored in x[v]
+ *  and added to a = <y|w> and s = <w|w>. Then b = sqrt(s - a*a), and one
+ *  more pass does y = (w - a y)/b and x = old y. So a step is the product
+ *  plus one pass, instead of the product plus four passes.
+ *  If s - a*a loses too many digits (b much smaller than a) the norm is
+ *  computed again after subtracting a y, which costs two more passes.
+ *  On exit y[v] is the next Lanczos vector, x[v] the current one, and
+ *  a[v] and b[v] the new coefficients; if b[v] is below the tolerance
+ *  y[v] and x[v] are left as they are, and the decomposition is over
+ *
+ *  Products that can give rows to a function call operator() below for
+ *  each row they compute; others use scalePrevious() before the product,
+ *  which then must do x += H y, and sumRows() after it
+ *
+ */
+#ifndef LANCZOS_STEP_H
+#define LANCZOS_STEP_H
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cassert>
+#include "Parallelizer.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename VectorType,typename RealType>
+	class LanczosStep {
+
+		typedef typename VectorType::value_type FieldType;
+
+		// below this s - a*a is computed again, see the file comment
+		static RealType cancellation() { return 1e-4; }
+
+		// sums of each thread are this far apart, so that threads do not
+		// write to the same cache line
+		enum {PADDING=8};
+
+		enum {PASS_SCALE,PASS_SUM,PASS_UPDATE,PASS_SUBTRACT,PASS_NORMALIZE};
+
+		class PassHelper {
+
+		public:
+
+			PassHelper(LanczosStep& step,size_t pass)
+			: step_(step),pass_(pass)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				step_.pass(pass_,threadNum);
+			}
+
+		private:
+
+			LanczosStep& step_;
+			size_t pass_;
+		}; // class PassHelper
+
+	public:
+
+		/*! bounds[t] to bounds[t+1] are the rows of thread t, and must be
+		 *  the rows that thread t gives to operator()
+		 */
+		LanczosStep(std::vector<VectorType>& x,
+		            std::vector<VectorType>& y,
+		            std::vector<RealType>& a,
+		            std::vector<RealType>& b,
+		            const std::vector<size_t>& bounds)
+		: x_(x),
+		  y_(y),
+		  a_(a),
+		  b_(b),
+		  bounds_(bounds),
+		  stride_(2*x.size() + PADDING),
+		  sums_((bounds.size()-1)*stride_,0),
+		  explicitNorm_(x.size(),false)
+		{
+			assert(x.size()==y.size() && b.size()==x.size());
+			assert(bounds.size()>1);
+			a_.resize(x_.size());
+		}
+
+		size_t threads() const { return bounds_.size()-1; }
+
+		//! Row i of H y[v], computed by thread threadNum
+		void operator()(size_t threadNum,size_t v,size_t i,const FieldType& hy)
+		{
+			FieldType w = hy - b_[v]*x_[v][i];
+			x_[v][i] = w;
+			RealType* sums = &sums_[threadNum*stride_ + 2*v];
+			sums[0] += realOfProduct(y_[v][i],w);
+			sums[1] += realOfProduct(w,w);
+		}
+
+		//! x = -b x, so that a product x += H y gives w
+		void scalePrevious()
+		{
+			runPass(PASS_SCALE);
+		}
+
+		//! a and s from an x = w computed by the product
+		void sumRows()
+		{
+			runPass(PASS_SUM);
+		}
+
+		//! Computes a and b, and the next vectors
+		void finish(RealType eps)
+		{
+			size_t vectors = x_.size();
+			std::vector<RealType> s(vectors,0);
+			bool someExplicit = false;
+			for (size_t v=0;v<vectors;v++) {
+				RealType atmp = 0;
+				for (size_t t=0;t<threads();t++) {
+					atmp += sums_[t*stride_ + 2*v];
+					s[v] += sums_[t*stride_ + 2*v + 1];
+				}
+				a_[v] = atmp;
+				RealType b2 = s[v] - atmp*atmp;
+				explicitNorm_[v] = (b2<=cancellation()*s[v]);
+				if (explicitNorm_[v]) {
+					someExplicit = true;
+					continue;
+				}
+				b_[v] = std::sqrt(b2);
+			}
+
+			if (someExplicit) {
+				for (size_t i=0;i<sums_.size();i++) sums_[i] = 0;
+				runPass(PASS_SUBTRACT);
+				for (size_t v=0;v<vectors;v++) {
+					if (!explicitNorm_[v]) continue;
+					RealType norm2 = 0;
+					for (size_t t=0;t<threads();t++) norm2 += sums_[t*stride_ + 2*v + 1];
+					b_[v] = std::sqrt(norm2);
+				}
+			}
+
+			for (size_t v=0;v<vectors;v++) done_.push_back(b_[v]<eps);
+			runPass(PASS_UPDATE);
+			if (someExplicit) runPass(PASS_NORMALIZE);
+		}
+
+	private:
+
+		void runPass(size_t pass)
+		{
+			PassHelper helper(*this,pass);
+			Parallelizer<PassHelper> parallelizer(threads());
+			parallelizer.loopCreate(helper);
+		}
+
+		void pass(size_t pass,size_t threadNum)
+		{
+			size_t start = bounds_[threadNum];
+			size_t end = bounds_[threadNum+1];
+			RealType* sums = &sums_[threadNum*stride_];
+			for (size_t v=0;v<x_.size();v++) {
+				VectorType& x = x_[v];
+				VectorType& y = y_[v];
+				RealType a = a_[v];
+				RealType b = b_[v];
+				switch (pass) {
+				case PASS_SCALE:
+					for (size_t i=start;i<end;i++) x[i] *= (-b);
+					break;
+				case PASS_SUM:
+					for (size_t i=start;i<end;i++) {
+						sums[2*v] += realOfProduct(y[i],x[i]);
+						sums[2*v+1] += realOfProduct(x[i],x[i]);
+					}
+					break;
+				case PASS_SUBTRACT:
+					if (!explicitNorm_[v]) break;
+					for (size_t i=start;i<end;i++) {
+						x[i] -= a*y[i];
+						sums[2*v+1] += realOfProduct(x[i],x[i]);
+					}
+					break;
+				case PASS_UPDATE:
+					if (done_[v]) break;
+					if (explicitNorm_[v]) {
+						// x is already w - a y
+						for (size_t i=start;i<end;i++) {
+							FieldType tmp = y[i];
+							y[i] = x[i];
+							x[i] = tmp;
+						}
+						break;
+					}
+					for (size_t i=start;i<end;i++) {
+						FieldType tmp = y[i];
+						y[i] = (x[i] - a*tmp)/b;
+						x[i] = tmp;
+					}
+					break;
+				case PASS_NORMALIZE:
+					if (done_[v] || !explicitNorm_[v]) break;
+					for (size_t i=start;i<end;i++) y[i] /= b;
+					break;
+				}
+			}
+		}
+
+		template<typename T>
+		static RealType realOfProduct(const T& a,const T& b)
+		{
+			return a*b;
+		}
+
+		template<typename T>
+		static RealType realOfProduct(const std::complex<T>& a,const std::complex<T>& b)
+		{
+			return std::real(std::conj(a)*b);
+		}
+
+		std::vector<VectorType>& x_;
+		std::vector<VectorType>& y_;
+		std::vector<RealType>& a_;
+		std::vector<RealType>& b_;
+		const std::vector<size_t>& bounds_;
+		size_t stride_;
+		std::vector<RealType> sums_;
+		std::vector<bool> explicitNorm_;
+		std::vector<bool> done_;
+	}; // class LanczosStep
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // LANCZOS_STEP_H
@@ -0,0 +1,390 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file MatrixStored.h
+ *
+ *  A stored Hamiltonian (sector) and its product x+=Hy
+ *
+ *  The product is split by rows among threads so that each thread gets
+ *  about the same number of non-zeros. Each row is computed by a single
+ *  thread, in the same order as CrsMatrix::matrixVectorProduct, so the
+ *  result does not depend on the number of threads
+ *
+ *  With MatrixStorage=SymmetricCRS in the input only the diagonal and
+ *  upper triangle are built and kept, see upperOnly() and
+ *  SymmetricCrsMatrix.h
+ *  With MatrixStorage=CompactCRS the matrix is kept with 32-bit columns
+ *  and a table of values, see CompactCrsMatrix.h
+ *  With MatrixStorage=SELL it is kept as sliced ELLPACK, with SIMD
+ *  products, see SellMatrix.h
+ *
+ *  With NumaPlacement= in the input, update() moves the rows of each
+ *  thread to its NUMA node, and numaPlace() does the same with the parts
+ *  of a Lanczos vector, once, when it is allocated; see NumaPlacement.h
+ *
+ */
+#ifndef MATRIX_STORED_H
+#define MATRIX_STORED_H
+#include <vector>
+#include <string>
+#include <cassert>
+#include <stdexcept>
+#include "CrsMatrix.h"
+#include "Parallelizer.h"
+#include "RowPartition.h"
+#include "NumaPlacement.h"
+#include "SymmetricCrsMatrix.h"
+#include "CompactCrsMatrix.h"
+#include "SellMatrix.h"
+#include "LanczosStep.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename FieldType>
+	class MatrixStored {
+
+	public:
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+		typedef SymmetricCrsMatrix<FieldType> SymmetricCrsMatrixType;
+		typedef CompactCrsMatrix<FieldType> CompactCrsMatrixType;
+		typedef SellMatrix<FieldType> SellMatrixType;
+
+		enum {STORAGE_CRS,STORAGE_SYMMETRIC_CRS,STORAGE_COMPACT_CRS,STORAGE_SELL};
+
+	private:
+
+		template<typename SomeVectorType>
+		class MatrixVectorHelper {
+
+		public:
+
+			MatrixVectorHelper(SomeVectorType& x,
+			                   const SomeVectorType& y,
+			                   const SparseMatrixType& matrix,
+			                   const std::vector<size_t>& partition)
+			: x_(x),y_(y),matrix_(matrix),partition_(partition)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				assert(threadNum+1<partition_.size());
+				size_t end = partition_[threadNum+1];
+				for (size_t i=partition_[threadNum];i<end;i++) {
+					typename SomeVectorType::value_type sum = x_[i];
+					for (int k=matrix_.getRowPtr(i);k<matrix_.getRowPtr(i+1);k++)
+						sum += matrix_.getValue(k)*y_[matrix_.getCol(k)];
+					x_[i] = sum;
+				}
+			}
+
+		private:
+
+			SomeVectorType& x_;
+			const SomeVectorType& y_;
+			const SparseMatrixType& matrix_;
+			const std::vector<size_t>& partition_;
+		}; // class MatrixVectorHelper
+
+		// as MatrixVectorHelper, but each row is read once for all vectors
+		template<typename SomeVectorType>
+		class MatrixVectorBlockHelper {
+
+		public:
+
+			MatrixVectorBlockHelper(std::vector<SomeVectorType>& x,
+			                        const std::vector<SomeVectorType>& y,
+			                        const SparseMatrixType& matrix,
+			                        const std::vector<size_t>& partition)
+			: x_(x),y_(y),matrix_(matrix),partition_(partition)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				assert(threadNum+1<partition_.size());
+				size_t end = partition_[threadNum+1];
+				for (size_t i=partition_[threadNum];i<end;i++) {
+					for (size_t v=0;v<x_.size();v++) {
+						typename SomeVectorType::value_type sum = x_[v][i];
+						for (int k=matrix_.getRowPtr(i);k<matrix_.getRowPtr(i+1);k++)
+							sum += matrix_.getValue(k)*y_[v][matrix_.getCol(k)];
+						x_[v][i] = sum;
+					}
+				}
+			}
+
+		private:
+
+			std::vector<SomeVectorType>& x_;
+			const std::vector<SomeVectorType>& y_;
+			const SparseMatrixType& matrix_;
+			const std::vector<size_t>& partition_;
+		}; // class MatrixVectorBlockHelper
+
+		// gives each row of H y[v] to op, see LanczosStep.h
+		template<typename SomeVectorType,typename SomeRowOpType>
+		class MatrixVectorRowsHelper {
+
+		public:
+
+			MatrixVectorRowsHelper(const std::vector<SomeVectorType>& y,
+			                       SomeRowOpType& op,
+			                       const SparseMatrixType& matrix,
+			                       const std::vector<size_t>& partition)
+			: y_(y),op_(op),matrix_(matrix),partition_(partition)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t end = partition_[threadNum+1];
+				for (size_t i=partition_[threadNum];i<end;i++) {
+					for (size_t v=0;v<y_.size();v++) {
+						typename SomeVectorType::value_type sum = 0;
+						for (int k=matrix_.getRowPtr(i);k<matrix_.getRowPtr(i+1);k++)
+							sum += matrix_.getValue(k)*y_[v][matrix_.getCol(k)];
+						op_(threadNum,v,i,sum);
+					}
+				}
+			}
+
+		private:
+
+			const std::vector<SomeVectorType>& y_;
+			SomeRowOpType& op_;
+			const SparseMatrixType& matrix_;
+			const std::vector<size_t>& partition_;
+		}; // class MatrixVectorRowsHelper
+
+	public:
+
+		MatrixStored(size_t threads,const std::string& storage = "CRS")
+		: threads_((threads==0) ? 1 : threads),
+		  storage_(storageFromString(storage)),
+		  rank_(0),
+		  crs_(new SparseMatrixType),
+		  symmetric_(threads_),
+		  compact_(threads_),
+		  sell_(threads_)
+		{}
+
+		MatrixStored(const MatrixStored& other)
+		: threads_(other.threads_),
+		  storage_(other.storage_),
+		  rank_(other.rank_),
+		  crs_(new SparseMatrixType(*other.crs_)),
+		  partition_(other.partition_),
+		  rowBounds_(other.rowBounds_),
+		  symmetric_(other.symmetric_),
+		  compact_(other.compact_),
+		  sell_(other.sell_)
+		{}
+
+		~MatrixStored()
+		{
+			delete crs_;
+		}
+
+		MatrixStored& operator=(const MatrixStored& other)
+		{
+			if (this==&other) return *this;
+			SparseMatrixType* crs = new SparseMatrixType(*other.crs_);
+			delete crs_;
+			crs_ = crs;
+			threads_ = other.threads_;
+			storage_ = other.storage_;
+			rank_ = other.rank_;
+			partition_ = other.partition_;
+			rowBounds_ = other.rowBounds_;
+			symmetric_ = other.symmetric_;
+			compact_ = other.compact_;
+			sell_ = other.sell_;
+			return *this;
+		}
+
+		//! Fill this matrix and then call update(), which may empty it
+		SparseMatrixType& matrix()
+		{
+			return (storage_==STORAGE_SYMMETRIC_CRS) ? symmetric_.matrix() : *crs_;
+		}
+
+		const SparseMatrixType& matrix() const
+		{
+			return (storage_==STORAGE_SYMMETRIC_CRS) ? symmetric_.matrix() : *crs_;
+		}
+
+		//! The builders need only fill the entries with column >= row
+		bool upperOnly() const { return (storage_==STORAGE_SYMMETRIC_CRS); }
+
+		//! Must be called after matrix() is filled or changed
+		void update()
+		{
+			if (storage_==STORAGE_SYMMETRIC_CRS) {
+				rank_ = symmetric_.rank();
+				symmetric_.update();
+				symmetric_.numaPlace();
+				symmetric_.rowBounds(rowBounds_);
+				return;
+			}
+
+			rank_ = crs_->row();
+			if (storage_==STORAGE_COMPACT_CRS) {
+				compact_.set(*crs_);
+				releaseCrs();
+				compact_.numaPlace();
+				compact_.rowBounds(rowBounds_);
+				return;
+			}
+
+			if (storage_==STORAGE_SELL) {
+				sell_.set(*crs_);
+				releaseCrs();
+				sell_.numaPlace();
+				sell_.rowBounds(rowBounds_);
+				return;
+			}
+
+			rowPartition(partition_,*crs_,rank_,threads_);
+			NumaPlacement::placeCrs("CRS",*crs_,partition_);
+			rowBounds_ = partition_;
+		}
+
+		size_t rank() const { return rank_; }
+
+		size_t threads() const { return threads_; }
+
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
+		{
+			if (storage_==STORAGE_SYMMETRIC_CRS)
+				return symmetric_.matrixVectorProduct(x,y);
+
+			if (storage_==STORAGE_COMPACT_CRS)
+				return compact_.matrixVectorProduct(x,y);
+
+			if (storage_==STORAGE_SELL)
+				return sell_.matrixVectorProduct(x,y);
+
+			if (threads_==1) return crs_->matrixVectorProduct(x,y);
+
+			assert(partition_.size()==threads_+1);
+			typedef MatrixVectorHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*crs_,partition_);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! x[v] += H y[v] for all v, reading H only once
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			assert(x.size()==y.size());
+			if (storage_==STORAGE_SYMMETRIC_CRS)
+				return symmetric_.matrixVectorProductBlock(x,y);
+
+			if (storage_==STORAGE_COMPACT_CRS)
+				return compact_.matrixVectorProductBlock(x,y);
+
+			if (storage_==STORAGE_SELL)
+				return sell_.matrixVectorProductBlock(x,y);
+
+			assert(partition_.size()==threads_+1);
+			typedef MatrixVectorBlockHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*crs_,partition_);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		/*! One step of the Lanczos recursion for each pair x[v], y[v], done
+		 *  together with the product, see LanczosStep.h
+		 */
+		template<typename SomeVectorType,typename RealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<RealType>& a,
+		                      std::vector<RealType>& b,
+		                      RealType eps) const
+		{
+			assert(x.size()==y.size());
+			typedef LanczosStep<SomeVectorType,RealType> LanczosStepType;
+			LanczosStepType step(x,y,a,b,rowBounds_);
+			if (storage_==STORAGE_SYMMETRIC_CRS) {
+				// rows are complete only at the end of the product
+				step.scalePrevious();
+				symmetric_.matrixVectorProductBlock(x,y);
+				step.sumRows();
+			} else if (storage_==STORAGE_COMPACT_CRS) {
+				compact_.matrixVectorProductRows(y,step);
+			} else if (storage_==STORAGE_SELL) {
+				sell_.matrixVectorProductRows(y,step);
+			} else {
+				typedef MatrixVectorRowsHelper<SomeVectorType,LanczosStepType> HelperType;
+				HelperType helper(y,step,*crs_,partition_);
+				Parallelizer<HelperType> parallelizer(threads_);
+				parallelizer.loopCreate(helper);
+			}
+
+			step.finish(eps);
+		}
+
+		//! Puts the rows of v of each thread on its NUMA node, see NumaPlacement.h
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType& v) const
+		{
+			if (v.size()==0 || !NumaPlacement::active()) return;
+			NumaPlacement::placeVector(&v[0],rowBounds_);
+		}
+
+	private:
+
+		// assigning an empty CrsMatrix would keep the capacity of its vectors
+		void releaseCrs()
+		{
+			delete crs_;
+			crs_ = new SparseMatrixType;
+		}
+
+		static size_t storageFromString(const std::string& storage)
+		{
+			if (storage=="CRS") return STORAGE_CRS;
+			if (storage=="SymmetricCRS") return STORAGE_SYMMETRIC_CRS;
+			if (storage=="CompactCRS") return STORAGE_COMPACT_CRS;
+			if (storage=="SELL") return STORAGE_SELL;
+			std::string str("MatrixStored: unknown MatrixStorage=" + storage);
+			str += ", expected CRS, SymmetricCRS, CompactCRS or SELL\n";
+			throw std::runtime_error(str);
+		}
+
+		size_t threads_;
+		size_t storage_;
+		size_t rank_;
+		SparseMatrixType* crs_;
+		std::vector<size_t> partition_;
+		std::vector<size_t> rowBounds_;
+		SymmetricCrsMatrixType symmetric_;
+		CompactCrsMatrixType compact_;
+		SellMatrixType sell_;
+	}; // class MatrixStored
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // MATRIX_STORED_H
@@ -0,0 +1,209 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file MultiWord.h
+ *
+ *  An unsigned word of N*64 bits, for bases with more spin-orbitals
+ *  than unsigned __int128 holds. It has the bitwise, shift, +, - and
+ *  comparison operators of an unsigned integer, on its N words of 64
+ *  bits, the lowest first
+ *
+ *  It converts from unsigned long long, so that w&1 or w>0 work, and to
+ *  bool, so that if (w&mask) works, but not to an integer; word(0) is
+ *  the lowest 64 bits. BitWord.h has count(), parity() and the masks
+ *  for it
+ *
+ */
+#ifndef MULTI_WORD_H
+#define MULTI_WORD_H
+#include <cstddef>
+
+namespace LanczosPlusPlus {
+
+	template<size_t N>
+	class MultiWord {
+
+	public:
+
+		typedef unsigned long long LimbType;
+
+		// converts to bool, but not to an integer, see operator BoolType
+		typedef LimbType (MultiWord::*BoolType)[N];
+
+		enum {LIMBS=N,LIMB_BITS=64};
+
+		MultiWord(LimbType w=0)
+		{
+			data_[0] = w;
+			for (size_t i=1;i<N;i++) data_[i] = 0;
+		}
+
+		const LimbType& word(size_t i) const { return data_[i]; }
+
+		LimbType& word(size_t i) { return data_[i]; }
+
+		MultiWord& operator&=(const MultiWord& other)
+		{
+			for (size_t i=0;i<N;i++) data_[i] &= other.data_[i];
+			return *this;
+		}
+
+		MultiWord& operator|=(const MultiWord& other)
+		{
+			for (size_t i=0;i<N;i++) data_[i] |= other.data_[i];
+			return *this;
+		}
+
+		MultiWord& operator^=(const MultiWord& other)
+		{
+			for (size_t i=0;i<N;i++) data_[i] ^= other.data_[i];
+			return *this;
+		}
+
+		MultiWord& operator<<=(size_t n)
+		{
+			size_t limbs = n/LIMB_BITS;
+			size_t bits = n%LIMB_BITS;
+			for (size_t i=N;i>0;i--) {
+				size_t j = i-1;
+				LimbType w = 0;
+				if (j>=limbs) {
+					w = data_[j-limbs]<<bits;
+					if (bits>0 && j>limbs) w |= data_[j-limbs-1]>>(LIMB_BITS-bits);
+				}
+				data_[j] = w;
+			}
+			return *this;
+		}
+
+		MultiWord& operator>>=(size_t n)
+		{
+			size_t limbs = n/LIMB_BITS;
+			size_t bits = n%LIMB_BITS;
+			for (size_t j=0;j<N;j++) {
+				LimbType w = 0;
+				if (j+limbs<N) {
+					w = data_[j+limbs]>>bits;
+					if (bits>0 && j+limbs+1<N) w |= data_[j+limbs+1]<<(LIMB_BITS-bits);
+				}
+				data_[j] = w;
+			}
+			return *this;
+		}
+
+		MultiWord& operator+=(const MultiWord& other)
+		{
+			LimbType carry = 0;
+			for (size_t i=0;i<N;i++) {
+				LimbType sum = data_[i] + carry;
+				carry = (sum<carry) ? 1 : 0;
+				data_[i] = sum + other.data_[i];
+				if (data_[i]<sum) carry = 1;
+			}
+			return *this;
+		}
+
+		MultiWord& operator-=(const MultiWord& other)
+		{
+			LimbType borrow = 0;
+			for (size_t i=0;i<N;i++) {
+				LimbType diff = data_[i] - other.data_[i];
+				LimbType nextBorrow = (data_[i]<other.data_[i]) ? 1 : 0;
+				if (diff<borrow) nextBorrow = 1;
+				data_[i] = diff - borrow;
+				borrow = nextBorrow;
+			}
+			return *this;
+		}
+
+		MultiWord operator~() const
+		{
+			MultiWord res;
+			for (size_t i=0;i<N;i++) res.data_[i] = ~data_[i];
+			return res;
+		}
+
+		MultiWord operator-() const
+		{
+			MultiWord res = ~(*this);
+			return res += 1;
+		}
+
+		//! True if any bit is set, as for the built-in words
+		operator BoolType() const
+		{
+			for (size_t i=0;i<N;i++)
+				if (data_[i]) return &MultiWord::data_;
+			return 0;
+		}
+
+		bool operator!() const { return !BoolType(*this); }
+
+		friend MultiWord operator&(MultiWord a,const MultiWord& b) { return a &= b; }
+
+		friend MultiWord operator|(MultiWord a,const MultiWord& b) { return a |= b; }
+
+		friend MultiWord operator^(MultiWord a,const MultiWord& b) { return a ^= b; }
+
+		friend MultiWord operator+(MultiWord a,const MultiWord& b) { return a += b; }
+
+		friend MultiWord operator-(MultiWord a,const MultiWord& b) { return a -= b; }
+
+		friend MultiWord operator<<(MultiWord a,size_t n) { return a <<= n; }
+
+		friend MultiWord operator>>(MultiWord a,size_t n) { return a >>= n; }
+
+		friend bool operator==(const MultiWord& a,const MultiWord& b)
+		{
+			for (size_t i=0;i<N;i++)
+				if (a.data_[i]!=b.data_[i]) return false;
+			return true;
+		}
+
+		friend bool operator!=(const MultiWord& a,const MultiWord& b) { return !(a==b); }
+
+		// or w==0 would be ambiguous with the comparison of BoolType
+		friend bool operator==(const MultiWord& a,LimbType b) { return (a==MultiWord(b)); }
+
+		friend bool operator!=(const MultiWord& a,LimbType b) { return !(a==MultiWord(b)); }
+
+		friend bool operator<(const MultiWord& a,const MultiWord& b)
+		{
+			for (size_t i=N;i>0;i--)
+				if (a.data_[i-1]!=b.data_[i-1]) return (a.data_[i-1]<b.data_[i-1]);
+			return false;
+		}
+
+		friend bool operator>(const MultiWord& a,const MultiWord& b) { return (b<a); }
+
+		friend bool operator<=(const MultiWord& a,const MultiWord& b) { return !(b<a); }
+
+		friend bool operator>=(const MultiWord& a,const MultiWord& b) { return !(a<b); }
+
+	private:
+
+		LimbType data_[N];
+	}; // class MultiWord
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // MULTI_WORD_H
@@ -0,0 +1,358 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file NumaPlacement.h
+ *
+ *  Places the pages of the stored Hamiltonian and of the Lanczos vectors
+ *  on the NUMA nodes of the threads that use them
+ *
+ *  With NumaPlacement=FirstTouch in the input, thread t of a Parallelizer
+ *  is pinned to a cpu, threads being spread evenly over the nodes, and
+ *  the pages of the rows of thread t are put on its node. This is the
+ *  placement a parallel first touch would give; it is done by moving the
+ *  pages afterwards, because CrsMatrix and LanczosSolver allocate and
+ *  zero their arrays from the main thread.
+ *  With NumaPlacement=Interleave pages go round robin over the nodes.
+ *  NumaPlacement=None, the default, does nothing. Only Linux is supported;
+ *  elsewhere, or with a single node, all of this does nothing
+ *
+ */
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include "TypeToString.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+namespace LanczosPlusPlus {
+
+	class NumaPlacement {
+
+		// flag MPOL_MF_MOVE of numaif.h, so that libnuma is not needed
+		enum {MOVE_PAGES_MOVE=2};
+
+		enum {PAGES_PER_CALL=1024};
+
+		// vectors smaller than this many pages are not worth moving
+		enum {MIN_VECTOR_PAGES=64};
+
+		struct Topology {
+
+			Topology() : mode(NUMA_NONE),vectorsReported(false) {}
+
+			size_t mode;
+			bool vectorsReported;
+			// cpus we may run on, sorted by node, and the node of each
+			std::vector<int> cpus;
+			std::vector<int> nodeOfCpu;
+			// nodes that have any of those cpus
+			std::vector<int> nodes;
+		};
+
+	public:
+
+		enum {NUMA_NONE,NUMA_FIRST_TOUCH,NUMA_INTERLEAVE};
+
+		//! Reads the topology; call it before starting any threads
+		static void init(const std::string& mode)
+		{
+			Topology& t = topology();
+			t.mode = modeFromString(mode);
+			t.cpus.clear();
+			t.nodeOfCpu.clear();
+			t.nodes.clear();
+			if (t.mode==NUMA_NONE) return;
+#ifdef __linux__
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if (sched_getaffinity(0,sizeof(set),&set)!=0) return;
+			std::vector<std::pair<int,int> > nodeAndCpu;
+			for (int c=0;c<CPU_SETSIZE;c++)
+				if (CPU_ISSET(c,&set)) nodeAndCpu.push_back(std::make_pair(nodeOf(c),c));
+			std::sort(nodeAndCpu.begin(),nodeAndCpu.end());
+			for (size_t i=0;i<nodeAndCpu.size();i++) {
+				t.nodeOfCpu.push_back(nodeAndCpu[i].first);
+				t.cpus.push_back(nodeAndCpu[i].second);
+				if (t.nodes.size()==0 || t.nodes.back()!=nodeAndCpu[i].first)
+					t.nodes.push_back(nodeAndCpu[i].first);
+			}
+#endif
+		}
+
+		static size_t mode() { return topology().mode; }
+
+		//! True if pages need to be moved at all
+		static bool active()
+		{
+			const Topology& t = topology();
+			if (t.mode==NUMA_NONE || t.nodes.size()<2) return false;
+#ifndef USE_PTHREADS
+			// all threads run one after the other on the main thread
+			if (t.mode==NUMA_FIRST_TOUCH) return false;
+#endif
+			return true;
+		}
+
+		static void print(std::ostream& os)
+		{
+			const Topology& t = topology();
+			os<<"#NumaPlacement="<<modeName(t.mode)<<" nodes="<<t.nodes.size();
+			os<<" cpus="<<t.cpus.size()<<"\n";
+		}
+
+		//! Pins the calling thread, number threadNum of threads, to its cpu
+		static void pin(size_t threadNum,size_t threads)
+		{
+#if defined(__linux__) && defined(USE_PTHREADS)
+			const Topology& t = topology();
+			if (t.mode!=NUMA_FIRST_TOUCH || t.cpus.size()==0) return;
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(t.cpus[cpuIndex(threadNum,threads)],&set);
+			pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+#endif
+		}
+
+		/*! Moves the pages of data so that elements [bounds[t],bounds[t+1])
+		 *  are on the node of thread t of bounds.size()-1 threads,
+		 *  and prints where they ended up
+		 */
+		template<typename T>
+		static void place(const std::string& name,
+		                  const T* data,
+		                  const std::vector<size_t>& bounds)
+		{
+			if (!active() || bounds.size()<2 || bounds.back()==bounds[0]) return;
+			std::vector<size_t> byteBounds(bounds.size());
+			for (size_t i=0;i<bounds.size();i++) byteBounds[i] = bounds[i]*sizeof(T);
+			const char* bytes = reinterpret_cast<const char*>(data);
+			movePages(bytes,byteBounds);
+			report(std::cout,name,bytes,byteBounds);
+		}
+
+		/*! As place(), for a Lanczos vector; called once, when the vector
+		 *  is allocated, and not by each product. Only the first vector
+		 *  placed is reported
+		 */
+		template<typename T>
+		static void placeVector(const T* data,const std::vector<size_t>& bounds)
+		{
+			if (!active() || bounds.size()<2) return;
+			size_t total = (bounds.back()-bounds[0])*sizeof(T);
+			if (total<MIN_VECTOR_PAGES*pageSize()) return;
+			std::vector<size_t> byteBounds(bounds.size());
+			for (size_t i=0;i<bounds.size();i++) byteBounds[i] = bounds[i]*sizeof(T);
+			const char* bytes = reinterpret_cast<const char*>(data);
+			movePages(bytes,byteBounds);
+
+			Topology& t = topology();
+			if (t.vectorsReported) return;
+			t.vectorsReported = true;
+			report(std::cout,"vector",bytes,byteBounds);
+		}
+
+		//! place() for the arrays of a CrsMatrix whose rows are split by partition
+		template<typename SomeCrsMatrixType>
+		static void placeCrs(const std::string& name,
+		                     const SomeCrsMatrixType& m,
+		                     const std::vector<size_t>& partition)
+		{
+			if (!active() || m.row()==0) return;
+			// there is one more row pointer than rows
+			std::vector<size_t> bounds(partition);
+			bounds.back()++;
+			place(name + ".rowPtr",&m.getRowPtr(0),bounds);
+			if (m.getRowPtr(m.row())==0) return;
+			for (size_t t=0;t<bounds.size();t++) bounds[t] = m.getRowPtr(partition[t]);
+			place(name + ".columns",&m.getCol(0),bounds);
+			place(name + ".values",&m.getValue(0),bounds);
+		}
+
+	private:
+
+		static Topology& topology()
+		{
+			static Topology t;
+			return t;
+		}
+
+		static size_t modeFromString(const std::string& mode)
+		{
+			if (mode=="None") return NUMA_NONE;
+			if (mode=="FirstTouch") return NUMA_FIRST_TOUCH;
+			if (mode=="Interleave") return NUMA_INTERLEAVE;
+			std::string str("NumaPlacement: unknown NumaPlacement=" + mode);
+			str += ", expected None, FirstTouch or Interleave\n";
+			throw std::runtime_error(str);
+		}
+
+		static const char* modeName(size_t mode)
+		{
+			if (mode==NUMA_FIRST_TOUCH) return "FirstTouch";
+			if (mode==NUMA_INTERLEAVE) return "Interleave";
+			return "None";
+		}
+
+		static size_t cpuIndex(size_t threadNum,size_t threads)
+		{
+			return (threadNum*topology().cpus.size())/threads;
+		}
+
+		static size_t pageSize()
+		{
+#ifdef __linux__
+			return sysconf(_SC_PAGESIZE);
+#else
+			return 4096;
+#endif
+		}
+
+		// node of a cpu, from sysfs, which has a nodeN entry in its directory
+		static int nodeOf(int cpu)
+		{
+#ifdef __linux__
+			std::string dirName("/sys/devices/system/cpu/cpu" + ttos(cpu));
+			DIR* dir = opendir(dirName.c_str());
+			if (!dir) return 0;
+			int node = 0;
+			struct dirent* entry = 0;
+			while ((entry = readdir(dir))!=0) {
+				if (std::strncmp(entry->d_name,"node",4)!=0) continue;
+				node = std::atoi(entry->d_name+4);
+				break;
+			}
+			closedir(dir);
+			return node;
+#else
+			return 0;
+#endif
+		}
+
+		// node where page number p (counting from the first page of the
+		// data) of thread threadNum should be
+		static int targetNode(size_t p,size_t threadNum,size_t threads)
+		{
+			const Topology& t = topology();
+			if (t.mode==NUMA_INTERLEAVE) return t.nodes[p % t.nodes.size()];
+			return t.nodeOfCpu[cpuIndex(threadNum,threads)];
+		}
+
+		// pages of [byteBounds[0],byteBounds.back()) of data, and their thread
+		static void pagesOf(std::vector<const char*>& pages,
+		                    std::vector<size_t>& owners,
+		                    const char* data,
+		                    const std::vector<size_t>& byteBounds)
+		{
+			size_t size = pageSize();
+			size_t threads = byteBounds.size()-1;
+			size_t first = (size_t(data + byteBounds[0])/size)*size;
+			size_t last = size_t(data + byteBounds.back() - 1);
+			pages.clear();
+			owners.clear();
+			size_t threadNum = 0;
+			for (size_t page=first;page<=last;page+=size) {
+				// a page goes with the thread of its first byte
+				size_t offset = std::max(page,size_t(data + byteBounds[0])) - size_t(data);
+				while (threadNum+1<threads && offset>=byteBounds[threadNum+1]) threadNum++;
+				pages.push_back(reinterpret_cast<const char*>(page));
+				owners.push_back(threadNum);
+			}
+		}
+
+		// status[i] is the node of pages[i] if nodes is empty, or after
+		// moving it to nodes[i]; negative if it failed
+		static void movePagesCall(const std::vector<const char*>& pages,
+		                          const std::vector<int>& nodes,
+		                          std::vector<int>& status)
+		{
+			status.assign(pages.size(),-1);
+#if defined(__linux__) && defined(SYS_move_pages)
+			for (size_t start=0;start<pages.size();start+=PAGES_PER_CALL) {
+				size_t count = std::min(size_t(PAGES_PER_CALL),pages.size()-start);
+				const int* nodesPtr = (nodes.size()==0) ? 0 : &nodes[start];
+				syscall(SYS_move_pages,0,count,&pages[start],nodesPtr,&status[start],
+				        (nodes.size()==0) ? 0 : MOVE_PAGES_MOVE);
+			}
+#endif
+		}
+
+		static void movePages(const char* data,const std::vector<size_t>& byteBounds)
+		{
+			std::vector<const char*> pages;
+			std::vector<size_t> owners;
+			pagesOf(pages,owners,data,byteBounds);
+			size_t threads = byteBounds.size()-1;
+			std::vector<int> nodes(pages.size());
+			for (size_t p=0;p<pages.size();p++)
+				nodes[p] = targetNode(p,owners[p],threads);
+			std::vector<int> status;
+			movePagesCall(pages,nodes,status);
+		}
+
+		static void report(std::ostream& os,
+		                   const std::string& name,
+		                   const char* data,
+		                   const std::vector<size_t>& byteBounds)
+		{
+			std::vector<const char*> pages;
+			std::vector<size_t> owners;
+			pagesOf(pages,owners,data,byteBounds);
+			std::vector<int> status;
+			movePagesCall(pages,std::vector<int>(),status);
+
+			const Topology& t = topology();
+			size_t threads = byteBounds.size()-1;
+			std::vector<size_t> onNode(t.nodes.size(),0);
+			size_t placed = 0;
+			size_t unknown = 0;
+			for (size_t p=0;p<pages.size();p++) {
+				if (status[p]==targetNode(p,owners[p],threads)) placed++;
+				size_t n = std::find(t.nodes.begin(),t.nodes.end(),status[p]) - t.nodes.begin();
+				if (n<t.nodes.size())
+					onNode[n]++;
+				else
+					unknown++;
+			}
+			os<<"#NumaPages "<<name<<" pages="<<pages.size()<<" placed="<<placed;
+			for (size_t n=0;n<t.nodes.size();n++)
+				os<<" node"<<t.nodes[n]<<"="<<onNode[n];
+			if (unknown>0) os<<" unknown="<<unknown;
+			os<<"\n";
+		}
+	}; // class NumaPlacement
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,102 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file Parallelizer.h
+ *
+ *  Calls helper.thread_function_(threadNum,threads) once for each
+ *  threadNum in [0,threads).
+ *  With USE_PTHREADS each call runs in its own pthread, otherwise
+ *  the calls are made one after the other, so that the work is split
+ *  the same way (and gives the same result) in both builds.
+ *  With NumaPlacement=FirstTouch each pthread is pinned to the cpu of
+ *  its threadNum, see NumaPlacement.h
+ *
+ */
+#ifndef PARALLELIZER_H
+#define PARALLELIZER_H
+#include <vector>
+#include <stdexcept>
+#include "NumaPlacement.h"
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+namespace LanczosPlusPlus {
+
+	template<typename HelperType>
+	class Parallelizer {
+
+		struct ThreadArgs {
+			HelperType* helper;
+			size_t threadNum;
+			size_t threads;
+		};
+
+	public:
+
+		Parallelizer(size_t threads)
+		: threads_((threads==0) ? 1 : threads)
+		{}
+
+		size_t threads() const { return threads_; }
+
+		void loopCreate(HelperType& helper) const
+		{
+#ifdef USE_PTHREADS
+			if (threads_>1) {
+				std::vector<pthread_t> threadIds(threads_);
+				std::vector<ThreadArgs> args(threads_);
+				for (size_t i=0;i<threads_;i++) {
+					args[i].helper = &helper;
+					args[i].threadNum = i;
+					args[i].threads = threads_;
+					int ret = pthread_create(&threadIds[i],0,threadFunctionWrapper,&args[i]);
+					if (ret!=0)
+						throw std::runtime_error("Parallelizer: pthread_create failed\n");
+				}
+				for (size_t i=0;i<threads_;i++)
+					pthread_join(threadIds[i],0);
+				return;
+			}
+#endif
+			for (size_t i=0;i<threads_;i++)
+				helper.thread_function_(i,threads_);
+		}
+
+	private:
+
+#ifdef USE_PTHREADS
+		static void* threadFunctionWrapper(void* arg)
+		{
+			ThreadArgs* args = static_cast<ThreadArgs*>(arg);
+			NumaPlacement::pin(args->threadNum,args->threads);
+			args->helper->thread_function_(args->threadNum,args->threads);
+			return 0;
+		}
+#endif
+
+		size_t threads_;
+	}; // class Parallelizer
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // PARALLELIZER_H
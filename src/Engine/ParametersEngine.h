@@ -81,6 +81,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef PARAMETERS_ENGINE_H
 #define PARAMETERS_ENGINE_H
 #include "Vector.h"
+#include <string>
 #include <stdexcept>
 
 namespace LanczosPlusPlus {
@@ -99,9 +100,105 @@ namespace LanczosPlusPlus {
 				io.rewind();
 			}
 			storeLanczosVectors = (tmp==1) ? true : false;
+
+			io.rewind();
+			threads = 1;
+			try {
+				io.readline(threads,"Threads=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			if (threads==0) threads = 1;
+
+			matrixStorage = "CRS";
+			try {
+				io.readline(matrixStorage,"MatrixStorage=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+
+			sectorCache = 2;
+			try {
+				io.readline(sectorCache,"SectorCache=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+
+			int tmp2 = 0;
+			try {
+				io.readline(tmp2,"UseReflectionSymmetry=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			useReflectionSymmetry = (tmp2==1) ? true : false;
+
+			tmp2 = 0;
+			try {
+				io.readline(tmp2,"UseTranslationSymmetry=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			useTranslationSymmetry = (tmp2==1) ? true : false;
+
+			tmp2 = 0;
+			try {
+				io.readline(tmp2,"UseSpinFlipSymmetry=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			useSpinFlipSymmetry = (tmp2==1) ? true : false;
+
+			tmp2 = 0;
+			try {
+				io.readline(tmp2,"UseGroupSymmetry=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			useGroupSymmetry = (tmp2==1) ? true : false;
+
+			tmp2 = 0;
+			try {
+				io.readline(tmp2,"UseOnTheFly=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			useOnTheFly = (tmp2==1) ? true : false;
+
+			// the direction of TranslationSymmetry.h if not given
+			try {
+				io.read(translationDirections,"TranslationDirections");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
+			if (translationDirections.size()==0) translationDirections.push_back(1);
+
+			numaPlacement = "None";
+			try {
+				io.readline(numaPlacement,"NumaPlacement=");
+			} catch (std::exception& e) {
+			}
+			io.rewind();
 		}
 		
 		bool storeLanczosVectors;
+		// number of threads for the product of the stored Hamiltonian
+		size_t threads;
+		// CRS, SymmetricCRS, CompactCRS or SELL, see MatrixStored.h
+		std::string matrixStorage;
+		// None, FirstTouch or Interleave, see NumaPlacement.h
+		std::string numaPlacement;
+		// sectors with other numbers of electrons to keep, see SectorCache.h
+		size_t sectorCache;
+		// also the reflection in SpinFlipSymmetry, see SpinFlipSymmetry.h
+		bool useReflectionSymmetry;
+		// generators of GroupSymmetry, see GroupSymmetry.h
+		bool useTranslationSymmetry;
+		bool useSpinFlipSymmetry;
+		std::vector<size_t> translationDirections;
+		// all the generators above together instead of one kind
+		bool useGroupSymmetry;
+		// products without storing the Hamiltonian, see InternalProductOnTheFly.h
+		bool useOnTheFly;
 	};
 
 	
@@ -110,6 +207,19 @@ namespace LanczosPlusPlus {
 	std::ostream& operator<<(std::ostream &os,const ParametersEngine<FieldType>& parameters)
 	{
 		os<<"parameters.storeLanczosVectors="<<parameters.storeLanczosVectors<<"\n";
+		os<<"parameters.threads="<<parameters.threads<<"\n";
+		os<<"parameters.matrixStorage="<<parameters.matrixStorage<<"\n";
+		os<<"parameters.numaPlacement="<<parameters.numaPlacement<<"\n";
+		os<<"parameters.sectorCache="<<parameters.sectorCache<<"\n";
+		os<<"parameters.useReflectionSymmetry="<<parameters.useReflectionSymmetry<<"\n";
+		os<<"parameters.useTranslationSymmetry="<<parameters.useTranslationSymmetry<<"\n";
+		os<<"parameters.useSpinFlipSymmetry="<<parameters.useSpinFlipSymmetry<<"\n";
+		os<<"parameters.translationDirections=";
+		for (size_t i=0;i<parameters.translationDirections.size();i++)
+			os<<parameters.translationDirections[i]<<" ";
+		os<<"\n";
+		os<<"parameters.useGroupSymmetry="<<parameters.useGroupSymmetry<<"\n";
+		os<<"parameters.useOnTheFly="<<parameters.useOnTheFly<<"\n";
 		return os;
 	}
 } // namespace LanczosPlusPlus
@@ -24,6 +24,9 @@ Please see full open source license included in file LICENSE.
 #include "ProgressIndicator.h"
 #include "CrsMatrix.h"
 #include "Vector.h"
+#include "MatrixStored.h"
+#include "BitWord.h"
+#include "ParametersEngine.h"
 
 namespace LanczosPlusPlus {
 
@@ -45,15 +48,6 @@ namespace LanczosPlusPlus {
 
 	}; // class ReflectionItem
 
-	bool operator==(const ReflectionItem& item1,const ReflectionItem& item2)
-	{
-		if (item1.type!=item2.type) return false;
-
-		if (item1.i==item2.j && item1.j==item2.i) return true;
-
-		return (item1.i==item2.i && item1.j==item2.j);
-	}
-
 	template<typename GeometryType,typename BasisType>
 	class ReflectionSymmetry  {
 
@@ -64,13 +58,63 @@ namespace LanczosPlusPlus {
 	public:
 
 		typedef PsimagLite::CrsMatrix<RealType> SparseMatrixType;
+		typedef MatrixStored<RealType> MatrixStoredType;
 		typedef std::vector<RealType> VectorType;
 
-		ReflectionSymmetry(const BasisType& basis,const GeometryType& geometry)
+		// the rows of the + or the - sector, see SymmetryBlockBuilder.h
+		class Sector {
+
+		public:
+
+			Sector(const std::vector<size_t>& states,
+			       const std::vector<size_t>& row,
+			       const std::vector<size_t>& minusRow,
+			       bool minus)
+			: states_(states),row_(row),minusRow_(minusRow),minus_(minus)
+			{}
+
+			size_t size() const { return states_.size(); }
+
+			size_t state(size_t a) const { return states_[a]; }
+
+			RealType weight(size_t a) const
+			{
+				return (paired(states_[a])) ? sqrt(2.0) : 1.0;
+			}
+
+			bool column(size_t t,size_t& b,RealType& value) const
+			{
+				b = row_[t];
+				if (b==none()) return false;
+				if (!paired(t)) {
+					value = 1.0;
+					return true;
+				}
+				value = 1.0/sqrt(2.0);
+				// the - combination is |i>-|j> with i its smaller state
+				if (minus_ && states_[b]!=t) value = -value;
+				return true;
+			}
+
+		private:
+
+			bool paired(size_t t) const { return (minusRow_[t]!=none()); }
+
+			const std::vector<size_t>& states_;
+			const std::vector<size_t>& row_;
+			const std::vector<size_t>& minusRow_;
+			bool minus_;
+		}; // class Sector
+
+		typedef Sector SectorType;
+
+		ReflectionSymmetry(const BasisType& basis,
+		                   const GeometryType& geometry,
+		                   const ParametersEngine<RealType>& params)
 		: progress_("ReflectionSymmetry",0),
 		  transform_(basis.size(),basis.size()),
 		  plusSector_(0),
-		  matrixStored_(2),
+		  matrixStored_(2,MatrixStoredType(params.threads,params.matrixStorage)),
 		  pointer_(0)
 		{
 			size_t hilbert = basis.size();
@@ -85,7 +129,7 @@ namespace LanczosPlusPlus {
 					WordType x = basis(ispace,dof);
 					for (size_t site=0;site<numberOfSites;site++) {
 						size_t reflectedSite = geometry.findReflection(site,termId);
-						size_t thisSiteContent = x & 1;
+						size_t thisSiteContent = BitWord<WordType>::low(x & 1);
 						x >>=1; // go to next site
 						addTo(y[dof],thisSiteContent,reflectedSite);
 						if (!x) break;
@@ -102,7 +146,8 @@ namespace LanczosPlusPlus {
 					buffer.push_back(item1);
 					continue;
 				}
-				// S|psi> != |psi>
+				// S|psi> != |psi>, the pair was added by its smaller index
+				if (yIndex<ispace) continue;
 				// Add normalized +
 				ItemType item2(ispace,yIndex,ItemType::PLUS);
 				buffer.push_back(item2);
@@ -113,20 +158,20 @@ namespace LanczosPlusPlus {
 			}
 //			s_.setRow(s_.rank(),counter);
 			setTransform(buffer);
+			setSectors(buffer,hilbert);
 //			checkTransform();
 		}
 
+		//! Builds the + and - sectors directly, see SymmetryBlockBuilder.h
 		template<typename SomeModelType>
 		void init(const SomeModelType& model,const BasisType& basis)
 		{
-			SparseMatrixType matrix2;
-			model.setupHamiltonian(matrix2,basis);
-			transformMatrix(matrixStored_,matrix2);
+			model.setupHamiltonian(matrixStored_,basis,*this,matrixStored_[0].threads());
 		}
 
-		size_t rank() const { return matrixStored_[pointer_].row(); }
+		size_t rank() const { return matrixStored_[pointer_].rank(); }
 
-		void transformMatrix(std::vector<SparseMatrixType>& matrix1,const SparseMatrixType& matrix) const
+		void transformMatrix(std::vector<MatrixStoredType>& matrix1,const SparseMatrixType& matrix) const
 		{
 			SparseMatrixType rT;
 			transposeConjugate(rT,transform_);
@@ -139,7 +184,9 @@ namespace LanczosPlusPlus {
 			multiply(matrix2,transform_,tmp);
 
 			assert(matrix1.size()==2);
-			split(matrix1[0],matrix1[1],matrix2);
+			split(matrix1[0].matrix(),matrix1[1].matrix(),matrix2);
+			matrix1[0].update();
+			matrix1[1].update();
 		}
 
 		void transformGs(VectorType& gs,size_t offset)
@@ -159,6 +206,13 @@ namespace LanczosPlusPlus {
 
 		size_t sectors() const { return 2; }
 
+		SectorType sector(size_t s) const
+		{
+			assert(s<2);
+			if (s==0) return SectorType(plusStates_,plusRow_,minusRow_,false);
+			return SectorType(minusStates_,minusRow_,minusRow_,true);
+		}
+
 		void setPointer(size_t p) { pointer_=p; }
 
 		std::string name() const { return "reflection"; }
@@ -169,19 +223,34 @@ namespace LanczosPlusPlus {
 			return matrixStored_[pointer_].matrixVectorProduct(x,y);
 		}
 
+		template<typename SomeVectorType,typename SomeRealType>
+		void lanczosStepBlock(std::vector<SomeVectorType>& x,
+		                      std::vector<SomeVectorType>& y,
+		                      std::vector<SomeRealType>& a,
+		                      std::vector<SomeRealType>& b,
+		                      SomeRealType eps) const
+		{
+			return matrixStored_[pointer_].lanczosStepBlock(x,y,a,b,eps);
+		}
+
+		template<typename SomeVectorType>
+		void numaPlace(const SomeVectorType& v) const
+		{
+			matrixStored_[pointer_].numaPlace(v);
+		}
+
 	private:
 
 		void addTo(WordType& yy,size_t what,size_t site) const
 		{
 			if (what==0) return;
-			WordType mask = (1<<site);
+			WordType mask = BitWord<WordType>::bit(site);
 			yy |= mask;
 		}
 
-		void setTransform(const std::vector<ItemType>& buffer2)
+		void setTransform(const std::vector<ItemType>& buffer)
 		{
-			std::vector<ItemType> buffer;
-			makeUnique(buffer,buffer2);
+			countSectors(buffer);
 			assert(buffer.size()==transform_.row());
 			size_t counter = 0;
 			RealType oneOverSqrt2 = 1.0/sqrt(2.0);
@@ -221,27 +290,35 @@ namespace LanczosPlusPlus {
 			transform_.checkValidity();
 		}
 
-		void makeUnique(std::vector<ItemType>& dest,const std::vector<ItemType>& src)
+		// the sector rows of each state, and the smaller state of each row
+		void setSectors(const std::vector<ItemType>& buffer,size_t hilbert)
+		{
+			plusRow_.resize(hilbert,none());
+			minusRow_.resize(hilbert,none());
+			for (size_t i=0;i<buffer.size();i++) {
+				const ItemType& item = buffer[i];
+				if (item.type==ItemType::MINUS) {
+					minusRow_[item.i] = minusRow_[item.j] = minusStates_.size();
+					minusStates_.push_back(item.i);
+					continue;
+				}
+				plusRow_[item.i] = plusRow_[item.j] = plusStates_.size();
+				plusStates_.push_back(item.i);
+			}
+			assert(plusStates_.size()==plusSector_);
+		}
+
+		static size_t none() { return size_t(-1); }
+
+		void countSectors(const std::vector<ItemType>& buffer)
 		{
 			size_t zeros=0;
 			size_t pluses=0;
 			size_t minuses=0;
-			for (size_t i=0;i<src.size();i++) {
-				ItemType item = src[i];
-				int x =  PsimagLite::isInVector(dest,item);
-				if (x>=0) continue;
-//				if (item.type ==ItemType::PLUS) {
-//					size_t i = item.i;
-//					size_t j = item.j;
-//					ItemType item2(j,i,ItemType::PLUS);
-//					x = PsimagLite::isInVector(dest,item2);
-//					if (x>=0) continue;
-//				}
-				if (item.type==ItemType::DIAGONAL) zeros++;
-				if (item.type==ItemType::PLUS) pluses++;
-				if (item.type==ItemType::MINUS) minuses++;
-
-				dest.push_back(item);
+			for (size_t i=0;i<buffer.size();i++) {
+				if (buffer[i].type==ItemType::DIAGONAL) zeros++;
+				if (buffer[i].type==ItemType::PLUS) pluses++;
+				if (buffer[i].type==ItemType::MINUS) minuses++;
 			}
 			std::ostringstream msg;
 			msg<<pluses<<" +, "<<minuses<<" -, "<<zeros<<" zeros.";
@@ -319,8 +396,12 @@ namespace LanczosPlusPlus {
 		PsimagLite::ProgressIndicator progress_;
 		SparseMatrixType transform_;
 		size_t plusSector_;
-		std::vector<SparseMatrixType> matrixStored_;
+		std::vector<MatrixStoredType> matrixStored_;
 		size_t pointer_;
+		std::vector<size_t> plusStates_;
+		std::vector<size_t> minusStates_;
+		std::vector<size_t> plusRow_;
+		std::vector<size_t> minusRow_;
 	}; // class ReflectionSymmetry
 } // namespace Dmrg
 
@@ -0,0 +1,56 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file RowPartition.h
+ *
+ *  Splits the rows of a sparse matrix among threads so that each
+ *  thread gets about the same number of non-zeros
+ *
+ */
+#ifndef ROW_PARTITION_H
+#define ROW_PARTITION_H
+#include <vector>
+
+namespace LanczosPlusPlus {
+
+	//! Thread t gets rows [partition[t],partition[t+1]); needs m.getRowPtr(i)
+	template<typename SomeMatrixType>
+	void rowPartition(std::vector<size_t>& partition,
+	                  const SomeMatrixType& m,
+	                  size_t rows,
+	                  size_t threads)
+	{
+		size_t nonZeros = (rows==0) ? 0 : m.getRowPtr(rows);
+		partition.resize(threads+1);
+		partition[0] = 0;
+		size_t row = 0;
+		for (size_t t=1;t<threads;t++) {
+			size_t target = (nonZeros*t)/threads;
+			while (row<rows && size_t(m.getRowPtr(row))<target) row++;
+			partition[t] = row;
+		}
+		partition[threads] = rows;
+	}
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // ROW_PARTITION_H
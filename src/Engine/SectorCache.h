@@ -0,0 +1,198 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SectorCache.h
+ *
+ *  The bases with other numbers of electrons that the Engine needs for
+ *  spectral functions and two-point correlations, keyed by
+ *  (electrons up, electrons down), each with the symmetry object that
+ *  stores its Hamiltonian
+ *
+ *  operator() returns a Sector, a handle that counts the references to
+ *  its entry. The basis is built by the model, with newBasis() and the
+ *  threads of ParametersEngine, on the first request of its sector, and
+ *  the Hamiltonian by the first InternalProduct made with symmetry();
+ *  later requests reuse both. When there are more than maxSectors
+ *  entries, the least recently used ones that no Sector refers to are
+ *  deleted, so maxSectors=0 keeps a sector only while it is in use.
+ *  Sectors must not outlive their cache
+ *
+ */
+#ifndef SECTOR_CACHE_H
+#define SECTOR_CACHE_H
+#include <map>
+#include <utility>
+#include <cassert>
+#include "ParametersEngine.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename ModelType,typename SymmetryType>
+	class SectorCache {
+
+		typedef typename ModelType::BasisType BasisType;
+		typedef typename ModelType::RealType RealType;
+		typedef std::pair<size_t,size_t> PairType;
+
+		struct Entry {
+
+			Entry(BasisType* basis1)
+			: basis(basis1),symmetry(0),refs(0),lastUse(0)
+			{}
+
+			BasisType* basis;
+			SymmetryType* symmetry;
+			size_t refs;
+			size_t lastUse;
+		};
+
+		typedef std::map<PairType,Entry> MapType;
+		typedef typename MapType::iterator IteratorType;
+
+	public:
+
+		class Sector {
+
+		public:
+
+			Sector(SectorCache& cache,IteratorType it)
+			: cache_(&cache),it_(it)
+			{
+				it_->second.refs++;
+			}
+
+			Sector(const Sector& other)
+			: cache_(other.cache_),it_(other.it_)
+			{
+				it_->second.refs++;
+			}
+
+			~Sector()
+			{
+				release();
+			}
+
+			Sector& operator=(const Sector& other)
+			{
+				if (it_==other.it_) return *this;
+				other.it_->second.refs++;
+				release();
+				cache_ = other.cache_;
+				it_ = other.it_;
+				return *this;
+			}
+
+			const BasisType& basis() const { return *(it_->second.basis); }
+
+			SymmetryType& symmetry() const { return cache_->symmetry(it_); }
+
+		private:
+
+			void release()
+			{
+				assert(it_->second.refs>0);
+				it_->second.refs--;
+				cache_->shrink();
+			}
+
+			SectorCache* cache_;
+			IteratorType it_;
+		}; // class Sector
+
+		SectorCache(const ModelType& model,
+		            const ParametersEngine<RealType>& params,
+		            size_t maxSectors)
+		: model_(model),params_(params),maxSectors_(maxSectors),clock_(0),builds_(0)
+		{}
+
+		~SectorCache()
+		{
+			for (IteratorType it=entries_.begin();it!=entries_.end();++it)
+				destroy(it->second);
+		}
+
+		Sector operator()(const PairType& parts)
+		{
+			IteratorType it = entries_.find(parts);
+			if (it==entries_.end()) {
+				BasisType* basis = model_.newBasis(parts.first,parts.second,params_.threads);
+				it = entries_.insert(std::make_pair(parts,Entry(basis))).first;
+				builds_++;
+			}
+			it->second.lastUse = ++clock_;
+			Sector sector(*this,it);
+			shrink();
+			return sector;
+		}
+
+		//! Number of bases built so far
+		size_t builds() const { return builds_; }
+
+	private:
+
+		SectorCache(const SectorCache&);
+
+		SectorCache& operator=(const SectorCache&);
+
+		SymmetryType& symmetry(IteratorType it)
+		{
+			Entry& entry = it->second;
+			if (entry.symmetry==0)
+				entry.symmetry = new SymmetryType(*entry.basis,model_.geometry(),params_);
+			return *entry.symmetry;
+		}
+
+		// deletes the least recently used unreferenced entries over maxSectors_
+		void shrink()
+		{
+			while (entries_.size()>maxSectors_) {
+				IteratorType victim = entries_.end();
+				for (IteratorType it=entries_.begin();it!=entries_.end();++it) {
+					if (it->second.refs>0) continue;
+					if (victim==entries_.end() || it->second.lastUse<victim->second.lastUse)
+						victim = it;
+				}
+				if (victim==entries_.end()) return;
+				destroy(victim->second);
+				entries_.erase(victim);
+			}
+		}
+
+		void destroy(Entry& entry)
+		{
+			delete entry.symmetry;
+			delete entry.basis;
+			entry.symmetry = 0;
+			entry.basis = 0;
+		}
+
+		const ModelType& model_;
+		const ParametersEngine<RealType>& params_;
+		size_t maxSectors_;
+		size_t clock_;
+		size_t builds_;
+		MapType entries_;
+	}; // class SectorCache
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SECTOR_CACHE_H
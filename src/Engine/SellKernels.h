@@ -0,0 +1,251 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SellKernels.h
+ *
+ *  Products of one slice of a SellMatrix: SELL_CHUNK rows, stored
+ *  column by column, so that entry j of row r is at j*SELL_CHUNK+r
+ *
+ *  There is a plain C++ kernel for any types, and for double and
+ *  std::complex<double> also AVX2 and AVX-512 kernels. These are
+ *  compiled with target attributes, so no -mavx flags are needed, and
+ *  sellSimdLevel() tells at runtime which ones the cpu can use.
+ *  Define SELL_NO_SIMD to build only the plain kernel
+ *
+ */
+#ifndef SELL_KERNELS_H
+#define SELL_KERNELS_H
+#include <complex>
+
+#if !defined(SELL_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SELL_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace LanczosPlusPlus {
+
+	enum {SELL_CHUNK=8};
+
+	enum {SELL_SIMD_NONE,SELL_SIMD_AVX2,SELL_SIMD_AVX512};
+
+	inline size_t sellSimdLevel()
+	{
+#ifdef SELL_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return SELL_SIMD_AVX512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return SELL_SIMD_AVX2;
+#endif
+		return SELL_SIMD_NONE;
+	}
+
+#ifdef SELL_X86_KERNELS
+#if !defined(__clang__)
+// gcc warns about the undefined registers used inside the intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+	__attribute__((target("avx2,fma")))
+	inline void sellSliceAvx2(double* sums,
+	                          const double* values,
+	                          const int* cols,
+	                          size_t width,
+	                          const double* y)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		for (size_t j=0;j<width;j++) {
+			const double* v = values + j*SELL_CHUNK;
+			const int* c = cols + j*SELL_CHUNK;
+			__m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+			__m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c+4));
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(v),_mm256_i32gather_pd(y,c0,8),acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(v+4),_mm256_i32gather_pd(y,c1,8),acc1);
+		}
+		_mm256_storeu_pd(sums,acc0);
+		_mm256_storeu_pd(sums+4,acc1);
+	}
+
+	__attribute__((target("avx512f")))
+	inline void sellSliceAvx512(double* sums,
+	                            const double* values,
+	                            const int* cols,
+	                            size_t width,
+	                            const double* y)
+	{
+		__m512d acc = _mm512_setzero_pd();
+		for (size_t j=0;j<width;j++) {
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols + j*SELL_CHUNK));
+			acc = _mm512_fmadd_pd(_mm512_loadu_pd(values + j*SELL_CHUNK),
+			                      _mm512_i32gather_pd(c,y,8),
+			                      acc);
+		}
+		_mm512_storeu_pd(sums,acc);
+	}
+
+	__attribute__((target("avx2,fma")))
+	inline __m256d sellLoadTwoComplexAvx2(const double* y,int c0,int c1)
+	{
+		__m256d b = _mm256_castpd128_pd256(_mm_loadu_pd(y + 2*c0));
+		return _mm256_insertf128_pd(b,_mm_loadu_pd(y + 2*c1),1);
+	}
+
+	// Complex numbers as (re,im) pairs. Two sums are kept,
+	// a = sum (vr*yr, vi*yr) and b = sum (vi*yi, vr*yi), and the product is
+	// (a.re - b.re, a.im + b.im), so each entry needs only two fma
+	__attribute__((target("avx2,fma")))
+	inline void sellSliceComplexAvx2(double* sums,
+	                                 const double* values,
+	                                 const int* cols,
+	                                 size_t width,
+	                                 const double* y)
+	{
+		__m256d a[4];
+		__m256d b[4];
+		for (size_t q=0;q<4;q++) a[q] = b[q] = _mm256_setzero_pd();
+		for (size_t j=0;j<width;j++) {
+			const double* v = values + 2*j*SELL_CHUNK;
+			const int* c = cols + j*SELL_CHUNK;
+			for (size_t q=0;q<4;q++) {
+				__m256d vv = _mm256_loadu_pd(v + 4*q);
+				__m256d yy = sellLoadTwoComplexAvx2(y,c[2*q],c[2*q+1]);
+				a[q] = _mm256_fmadd_pd(vv,_mm256_movedup_pd(yy),a[q]);
+				b[q] = _mm256_fmadd_pd(_mm256_permute_pd(vv,0x5),_mm256_permute_pd(yy,0xF),b[q]);
+			}
+		}
+		for (size_t q=0;q<4;q++)
+			_mm256_storeu_pd(sums + 4*q,_mm256_addsub_pd(a[q],b[q]));
+	}
+
+	__attribute__((target("avx512f")))
+	inline void sellSliceComplexAvx512(double* sums,
+	                                   const double* values,
+	                                   const int* cols,
+	                                   size_t width,
+	                                   const double* y)
+	{
+		__m512d a[2];
+		__m512d b[2];
+		for (size_t q=0;q<2;q++) a[q] = b[q] = _mm512_setzero_pd();
+		for (size_t j=0;j<width;j++) {
+			const double* v = values + 2*j*SELL_CHUNK;
+			const int* c = cols + j*SELL_CHUNK;
+			for (size_t q=0;q<2;q++) {
+				const int* cq = c + 4*q;
+				__m256d y01 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(y + 2*cq[0])),
+				                                   _mm_loadu_pd(y + 2*cq[1]),1);
+				__m256d y23 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(y + 2*cq[2])),
+				                                   _mm_loadu_pd(y + 2*cq[3]),1);
+				__m512d yy = _mm512_insertf64x4(_mm512_castpd256_pd512(y01),y23,1);
+				__m512d vv = _mm512_loadu_pd(v + 8*q);
+				a[q] = _mm512_fmadd_pd(vv,_mm512_movedup_pd(yy),a[q]);
+				b[q] = _mm512_fmadd_pd(_mm512_permute_pd(vv,0x55),_mm512_permute_pd(yy,0xFF),b[q]);
+			}
+		}
+		for (size_t q=0;q<2;q++) {
+			__m512d sum = _mm512_mask_sub_pd(_mm512_add_pd(a[q],b[q]),0x55,a[q],b[q]);
+			_mm512_storeu_pd(sums + 8*q,sum);
+		}
+	}
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+	//! sums[r] = sum over j of values[j*SELL_CHUNK+r]*y[cols[j*SELL_CHUNK+r]]
+	template<typename FieldType,typename ValueType>
+	void sellSlicePlain(ValueType* sums,
+	                    const FieldType* values,
+	                    const int* cols,
+	                    size_t width,
+	                    const ValueType* y)
+	{
+		for (size_t r=0;r<SELL_CHUNK;r++) sums[r] = 0;
+		for (size_t j=0;j<width;j++)
+			for (size_t r=0;r<SELL_CHUNK;r++)
+				sums[r] += values[j*SELL_CHUNK+r]*y[cols[j*SELL_CHUNK+r]];
+	}
+
+	//! Picks the fastest kernel for these types that the cpu (simd) can run
+	template<typename FieldType,typename ValueType>
+	struct SellKernel {
+
+		static void slice(ValueType* sums,
+		                  const FieldType* values,
+		                  const int* cols,
+		                  size_t width,
+		                  const ValueType* y,
+		                  size_t)
+		{
+			sellSlicePlain(sums,values,cols,width,y);
+		}
+	}; // struct SellKernel
+
+	template<>
+	struct SellKernel<double,double> {
+
+		static void slice(double* sums,
+		                  const double* values,
+		                  const int* cols,
+		                  size_t width,
+		                  const double* y,
+		                  size_t simd)
+		{
+#ifdef SELL_X86_KERNELS
+			if (simd==SELL_SIMD_AVX512)
+				return sellSliceAvx512(sums,values,cols,width,y);
+			if (simd==SELL_SIMD_AVX2)
+				return sellSliceAvx2(sums,values,cols,width,y);
+#endif
+			sellSlicePlain(sums,values,cols,width,y);
+		}
+	}; // struct SellKernel<double,double>
+
+	template<>
+	struct SellKernel<std::complex<double>,std::complex<double> > {
+
+		typedef std::complex<double> ComplexType;
+
+		static void slice(ComplexType* sums,
+		                  const ComplexType* values,
+		                  const int* cols,
+		                  size_t width,
+		                  const ComplexType* y,
+		                  size_t simd)
+		{
+#ifdef SELL_X86_KERNELS
+			// std::complex<double> is laid out as double[2]
+			double* s = reinterpret_cast<double*>(sums);
+			const double* v = reinterpret_cast<const double*>(values);
+			const double* yy = reinterpret_cast<const double*>(y);
+			if (simd==SELL_SIMD_AVX512)
+				return sellSliceComplexAvx512(s,v,cols,width,yy);
+			if (simd==SELL_SIMD_AVX2)
+				return sellSliceComplexAvx2(s,v,cols,width,yy);
+#endif
+			sellSlicePlain(sums,values,cols,width,y);
+		}
+	}; // struct SellKernel<std::complex<double>,std::complex<double> >
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SELL_KERNELS_H
@@ -0,0 +1,353 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SellMatrix.h
+ *
+ *  A sparse matrix in SELL-C-sigma (sliced ELLPACK) format
+ *
+ *  Rows are sorted by length within windows of SORT_WINDOW rows, and then
+ *  cut into slices of SELL_CHUNK rows. Each slice is padded to its
+ *  longest row and stored column by column, so the product of a slice
+ *  is done SELL_CHUNK rows at a time by the kernels in SellKernels.h.
+ *  Rows of our Hamiltonians have similar lengths, so there is little
+ *  padding. Slices are split among threads by their number of entries
+ *
+ */
+#ifndef SELL_MATRIX_H
+#define SELL_MATRIX_H
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cassert>
+#include <stdexcept>
+#include "CrsMatrix.h"
+#include "TypeToString.h"
+#include "Parallelizer.h"
+#include "RowPartition.h"
+#include "SellKernels.h"
+#include "NumaPlacement.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename FieldType>
+	class SellMatrix {
+
+		enum {SORT_WINDOW=32*SELL_CHUNK};
+
+		// sorts rows by decreasing length
+		class LongerRow {
+
+		public:
+
+			LongerRow(const std::vector<size_t>& lengths) : lengths_(lengths) {}
+
+			bool operator()(size_t a,size_t b) const
+			{
+				return (lengths_[a]>lengths_[b]);
+			}
+
+		private:
+
+			const std::vector<size_t>& lengths_;
+		}; // class LongerRow
+
+		// so that RowPartition sees slices as rows
+		class SliceOffsets {
+
+		public:
+
+			SliceOffsets(const std::vector<size_t>& offsets) : offsets_(offsets) {}
+
+			size_t getRowPtr(size_t slice) const { return offsets_[slice]; }
+
+		private:
+
+			const std::vector<size_t>& offsets_;
+		}; // class SliceOffsets
+
+	public:
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+
+	private:
+
+		template<typename SomeVectorType>
+		class MatrixVectorHelper {
+
+		public:
+
+			MatrixVectorHelper(SomeVectorType& x,
+			                   const SomeVectorType& y,
+			                   const SellMatrix& matrix)
+			: x_(x),y_(y),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t end = matrix_.partition_[threadNum+1];
+				for (size_t s=matrix_.partition_[threadNum];s<end;s++)
+					matrix_.sliceProduct(x_,y_,s);
+			}
+
+		private:
+
+			SomeVectorType& x_;
+			const SomeVectorType& y_;
+			const SellMatrix& matrix_;
+		}; // class MatrixVectorHelper
+
+		template<typename SomeVectorType>
+		class MatrixVectorBlockHelper {
+
+		public:
+
+			MatrixVectorBlockHelper(std::vector<SomeVectorType>& x,
+			                        const std::vector<SomeVectorType>& y,
+			                        const SellMatrix& matrix)
+			: x_(x),y_(y),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t end = matrix_.partition_[threadNum+1];
+				// the slice stays in cache while it is used for all vectors
+				for (size_t s=matrix_.partition_[threadNum];s<end;s++)
+					for (size_t v=0;v<x_.size();v++)
+						matrix_.sliceProduct(x_[v],y_[v],s);
+			}
+
+		private:
+
+			std::vector<SomeVectorType>& x_;
+			const std::vector<SomeVectorType>& y_;
+			const SellMatrix& matrix_;
+		}; // class MatrixVectorBlockHelper
+
+		template<typename SomeVectorType,typename SomeRowOpType>
+		class MatrixVectorRowsHelper {
+
+		public:
+
+			MatrixVectorRowsHelper(const std::vector<SomeVectorType>& y,
+			                       SomeRowOpType& op,
+			                       const SellMatrix& matrix)
+			: y_(y),op_(op),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t end = matrix_.partition_[threadNum+1];
+				for (size_t s=matrix_.partition_[threadNum];s<end;s++)
+					for (size_t v=0;v<y_.size();v++)
+						matrix_.sliceProductRows(y_[v],op_,s,v,threadNum);
+			}
+
+		private:
+
+			const std::vector<SomeVectorType>& y_;
+			SomeRowOpType& op_;
+			const SellMatrix& matrix_;
+		}; // class MatrixVectorRowsHelper
+
+	public:
+
+		SellMatrix(size_t threads)
+		: threads_((threads==0) ? 1 : threads),rank_(0),simd_(SELL_SIMD_NONE)
+		{}
+
+		void set(const SparseMatrixType& full)
+		{
+			rank_ = full.row();
+			if (rank_>size_t(0x7fffffff)) {
+				std::string str("SellMatrix: rank " + ttos(rank_));
+				str += " does not fit in 32-bit columns, use MatrixStorage=CRS\n";
+				throw std::runtime_error(str);
+			}
+
+			std::vector<size_t> lengths(rank_);
+			for (size_t i=0;i<rank_;i++)
+				lengths[i] = full.getRowPtr(i+1) - full.getRowPtr(i);
+
+			size_t slices = (rank_ + SELL_CHUNK - 1)/SELL_CHUNK;
+			perm_.resize(rank_);
+			for (size_t i=0;i<rank_;i++) perm_[i] = i;
+			for (size_t start=0;start<rank_;start+=SORT_WINDOW) {
+				size_t end = std::min(start+SORT_WINDOW,rank_);
+				std::stable_sort(perm_.begin()+start,perm_.begin()+end,LongerRow(lengths));
+			}
+
+			sliceStart_.resize(slices+1);
+			size_t total = 0;
+			for (size_t s=0;s<slices;s++) {
+				sliceStart_[s] = total;
+				size_t width = 0;
+				for (size_t r=0;r<SELL_CHUNK;r++) {
+					size_t p = s*SELL_CHUNK + r;
+					if (p<rank_ && lengths[perm_[p]]>width) width = lengths[perm_[p]];
+				}
+				total += width*SELL_CHUNK;
+			}
+			sliceStart_[slices] = total;
+
+			// padding points to column 0 with a zero value
+			values_.assign(total,0);
+			columns_.assign(total,0);
+			for (size_t s=0;s<slices;s++) {
+				for (size_t r=0;r<SELL_CHUNK;r++) {
+					size_t p = s*SELL_CHUNK + r;
+					if (p>=rank_) break;
+					size_t row = perm_[p];
+					size_t j = 0;
+					for (int k=full.getRowPtr(row);k<full.getRowPtr(row+1);k++) {
+						size_t index = sliceStart_[s] + j*SELL_CHUNK + r;
+						values_[index] = full.getValue(k);
+						columns_[index] = full.getCol(k);
+						j++;
+					}
+				}
+			}
+
+			rowPartition(partition_,SliceOffsets(sliceStart_),slices,threads_);
+			simd_ = sellSimdLevel();
+		}
+
+		size_t rank() const { return rank_; }
+
+		//! Thread t computes rows [bounds[t],bounds[t+1]), before the permutation
+		void rowBounds(std::vector<size_t>& bounds) const
+		{
+			bounds.resize(partition_.size());
+			for (size_t t=0;t<bounds.size();t++)
+				bounds[t] = std::min(partition_[t]*SELL_CHUNK,rank_);
+		}
+
+		//! Puts the slices of each thread on its NUMA node, see NumaPlacement.h
+		void numaPlace() const
+		{
+			if (rank_==0) return;
+			std::vector<size_t> bounds;
+			rowBounds(bounds);
+			NumaPlacement::place("SELL.permutation",&perm_[0],bounds);
+			if (values_.size()==0) return;
+			for (size_t t=0;t<bounds.size();t++) bounds[t] = sliceStart_[partition_[t]];
+			NumaPlacement::place("SELL.columns",&columns_[0],bounds);
+			NumaPlacement::place("SELL.values",&values_[0],bounds);
+		}
+
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
+		{
+			assert(x.size()==rank_ && y.size()==rank_);
+			typedef MatrixVectorHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! x[v] += H y[v] for all v, reading H only once
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			typedef MatrixVectorBlockHelper<SomeVectorType> HelperType;
+			HelperType helper(x,y,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+		//! Calls op(threadNum,v,i,(H y[v])_i) for each row i and vector v
+		template<typename SomeVectorType,typename SomeRowOpType>
+		void matrixVectorProductRows(const std::vector<SomeVectorType>& y,
+		                             SomeRowOpType& op) const
+		{
+			typedef MatrixVectorRowsHelper<SomeVectorType,SomeRowOpType> HelperType;
+			HelperType helper(y,op,*this);
+			Parallelizer<HelperType> parallelizer(threads_);
+			parallelizer.loopCreate(helper);
+		}
+
+	private:
+
+		template<typename SomeVectorType>
+		void sliceProduct(SomeVectorType& x,const SomeVectorType& y,size_t s) const
+		{
+			typedef typename SomeVectorType::value_type ValueType;
+
+			size_t start = sliceStart_[s];
+			size_t width = (sliceStart_[s+1] - start)/SELL_CHUNK;
+			if (width==0) return;
+
+			ValueType sums[SELL_CHUNK];
+			SellKernel<FieldType,ValueType>::slice(sums,
+			                                       &values_[start],
+			                                       &columns_[start],
+			                                       width,
+			                                       &y[0],
+			                                       simd_);
+			for (size_t r=0;r<SELL_CHUNK;r++) {
+				size_t p = s*SELL_CHUNK + r;
+				if (p>=rank_) break;
+				x[perm_[p]] += sums[r];
+			}
+		}
+
+		template<typename SomeVectorType,typename SomeRowOpType>
+		void sliceProductRows(const SomeVectorType& y,
+		                      SomeRowOpType& op,
+		                      size_t s,
+		                      size_t v,
+		                      size_t threadNum) const
+		{
+			typedef typename SomeVectorType::value_type ValueType;
+
+			size_t start = sliceStart_[s];
+			size_t width = (sliceStart_[s+1] - start)/SELL_CHUNK;
+			ValueType sums[SELL_CHUNK];
+			for (size_t r=0;r<SELL_CHUNK;r++) sums[r] = 0;
+			if (width>0)
+				SellKernel<FieldType,ValueType>::slice(sums,
+				                                       &values_[start],
+				                                       &columns_[start],
+				                                       width,
+				                                       &y[0],
+				                                       simd_);
+			// rows without entries still need their call
+			for (size_t r=0;r<SELL_CHUNK;r++) {
+				size_t p = s*SELL_CHUNK + r;
+				if (p>=rank_) break;
+				op(threadNum,v,perm_[p],sums[r]);
+			}
+		}
+
+		size_t threads_;
+		size_t rank_;
+		size_t simd_;
+		std::vector<size_t> perm_;
+		std::vector<size_t> sliceStart_;
+		std::vector<FieldType> values_;
+		std::vector<int> columns_;
+		std::vector<size_t> partition_;
+	}; // class SellMatrix
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SELL_MATRIX_H
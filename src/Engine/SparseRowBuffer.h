@@ -0,0 +1,125 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SparseRowBuffer.h
+ *
+ *  One row of the Hamiltonian, as the models compute it: the same
+ *  column may be added more than once
+ *
+ *  Repeated columns are summed as they are added, through a dense array
+ *  with the position in the row of each column, so add() is O(1).
+ *  clear() resets only the columns of the row, and keeps all the memory,
+ *  so a buffer that is reused for all rows stops allocating once it has
+ *  seen the longest row and the largest column. The dense array takes
+ *  4 bytes per column; reserveColumns() allocates it at once
+ *
+ */
+#ifndef SPARSE_ROW_BUFFER_H
+#define SPARSE_ROW_BUFFER_H
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace LanczosPlusPlus {
+
+	template<typename FieldType>
+	class SparseRowBuffer {
+
+		typedef std::pair<size_t,FieldType> PairType;
+		typedef unsigned int PositionType;
+
+		static bool lessByColumn(const PairType& a,const PairType& b)
+		{
+			return (a.first<b.first);
+		}
+
+		static PositionType none() { return PositionType(-1); }
+
+	public:
+
+		SparseRowBuffer() {}
+
+		void reserveColumns(size_t columns)
+		{
+			if (columns>position_.size()) position_.resize(columns,none());
+		}
+
+		void add(size_t col,const FieldType& value)
+		{
+			if (col>=position_.size())
+				position_.resize(std::max(col+1,2*position_.size()),none());
+			PositionType p = position_[col];
+			if (p!=none()) {
+				data_[p].second += value;
+				return;
+			}
+			position_[col] = data_.size();
+			data_.push_back(PairType(col,value));
+		}
+
+		void clear()
+		{
+			for (size_t i=0;i<data_.size();i++) position_[data_[i].first] = none();
+			data_.clear();
+		}
+
+		//! Sorts by column, returns number of columns; call add() only after clear()
+		size_t finalize()
+		{
+			std::sort(data_.begin(),data_.end(),lessByColumn);
+			for (size_t i=0;i<data_.size();i++) position_[data_[i].first] = i;
+			return data_.size();
+		}
+
+		size_t size() const { return data_.size(); }
+
+		size_t col(size_t i) const
+		{
+			assert(i<data_.size());
+			return data_[i].first;
+		}
+
+		const FieldType& value(size_t i) const
+		{
+			assert(i<data_.size());
+			return data_[i].second;
+		}
+
+		//! Sum of value*y[col] over everything added so far
+		template<typename SomeVectorType>
+		typename SomeVectorType::value_type matrixVectorProduct(const SomeVectorType& y) const
+		{
+			typename SomeVectorType::value_type sum = 0;
+			for (size_t i=0;i<data_.size();i++)
+				sum += data_[i].second*y[data_[i].first];
+			return sum;
+		}
+
+	private:
+
+		std::vector<PairType> data_;
+		std::vector<PositionType> position_;
+	}; // class SparseRowBuffer
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SPARSE_ROW_BUFFER_H
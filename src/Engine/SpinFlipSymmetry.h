@@ -0,0 +1,61 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SpinFlipSymmetry.h
+ *
+ *  The exchange of the up and down words of each state, a symmetry of
+ *  the Hubbard and t-J models when there are as many electrons up as
+ *  down. With UseReflectionSymmetry=1 in the input the reflection of
+ *  the Geometry is a second generator, and there are four sectors
+ *  instead of two
+ *
+ *  This is GroupSymmetry.h with these generators only; their characters
+ *  are real, and so are the sectors and the ground state
+ *
+ */
+#ifndef SPIN_FLIP_SYMM_H
+#define SPIN_FLIP_SYMM_H
+#include "GroupSymmetry.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename GeometryType,typename BasisType>
+	class SpinFlipSymmetry
+	: public GroupSymmetry<GeometryType,BasisType,typename GeometryType::RealType> {
+
+		typedef typename GeometryType::RealType RealType;
+		typedef GroupSymmetry<GeometryType,BasisType,RealType> BaseType;
+
+	public:
+
+		SpinFlipSymmetry(const BasisType& basis,
+		                 const GeometryType& geometry,
+		                 const ParametersEngine<RealType>& params)
+		: BaseType(basis,geometry,params,std::vector<size_t>(),params.useReflectionSymmetry,true,"SpinFlipSymmetry")
+		{}
+
+		std::string name() const { return "spinflip"; }
+	}; // class SpinFlipSymmetry
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SPIN_FLIP_SYMM_H
@@ -0,0 +1,325 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SymmetricCrsMatrix.h
+ *
+ *  A Hermitian matrix stored as its diagonal and upper triangle only
+ *
+ *  The builders fill matrix() with the entries with column >= row only,
+ *  see upperOnly() in MatrixStored.h, so the full matrix never exists.
+ *  Row i of the upper triangle gives x[i] += H(i,j)*y[j] and also
+ *  x[j] += conj(H(i,j))*y[i]. With more than one thread, the second
+ *  update would race, so each thread accumulates into its own vector,
+ *  which only needs to cover columns from the first row of the thread,
+ *  and the vectors are then added into x, also in parallel. These
+ *  vectors are allocated by update(), or by the first product with more
+ *  vectors than before, and reused by all later products
+ *
+ */
+#ifndef SYMMETRIC_CRS_MATRIX_H
+#define SYMMETRIC_CRS_MATRIX_H
+#include <vector>
+#include <complex>
+#include <cassert>
+#include "CrsMatrix.h"
+#include "Parallelizer.h"
+#include "RowPartition.h"
+#include "NumaPlacement.h"
+
+namespace LanczosPlusPlus {
+
+	//! The real type of T, which may be complex
+	template<typename T>
+	struct RealOf {
+		typedef T Type;
+	};
+
+	template<typename T>
+	struct RealOf<std::complex<T> > {
+		typedef T Type;
+	};
+
+	template<typename FieldType>
+	class SymmetricCrsMatrix {
+
+		typedef typename RealOf<FieldType>::Type RealType;
+		typedef std::complex<RealType> ComplexType;
+
+	public:
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+
+	private:
+
+		// the rows of each thread into its buffers, for y[0] ... y[n-1]
+		template<typename SomeVectorType>
+		class ProductHelper {
+
+		public:
+
+			ProductHelper(const SomeVectorType* y,
+			              size_t n,
+			              const SymmetricCrsMatrix& matrix)
+			: y_(y),n_(n),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t start = matrix_.partition_[threadNum];
+				size_t end = matrix_.partition_[threadNum+1];
+				for (size_t v=0;v<n_;v++) {
+					BufferType& buffer = matrix_.buffer(threadNum,v,tag());
+					for (size_t i=0;i<buffer.size();i++) buffer[i] = 0;
+				}
+
+				for (size_t i=start;i<end;i++)
+					for (size_t v=0;v<n_;v++)
+						matrix_.rowProduct(matrix_.buffer(threadNum,v,tag()),start,y_[v],i);
+			}
+
+		private:
+
+			typedef typename SomeVectorType::value_type ValueType;
+			typedef std::vector<ValueType> BufferType;
+
+			static const ValueType* tag() { return 0; }
+
+			const SomeVectorType* y_;
+			size_t n_;
+			const SymmetricCrsMatrix& matrix_;
+		}; // class ProductHelper
+
+		// x[v] += the buffers of all threads, for x[0] ... x[n-1]
+		template<typename SomeVectorType>
+		class ReduceHelper {
+
+		public:
+
+			ReduceHelper(SomeVectorType* x,
+			             size_t n,
+			             const SymmetricCrsMatrix& matrix)
+			: x_(x),n_(n),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				const std::vector<size_t>& partition = matrix_.partition_;
+				size_t end = partition[threadNum+1];
+				for (size_t v=0;v<n_;v++) {
+					SomeVectorType& x = x_[v];
+					for (size_t i=partition[threadNum];i<end;i++) {
+						ValueType sum = x[i];
+						// only threads up to this one have written to row i
+						for (size_t t=0;t<=threadNum;t++)
+							sum += matrix_.buffer(t,v,tag())[i-partition[t]];
+						x[i] = sum;
+					}
+				}
+			}
+
+		private:
+
+			typedef typename SomeVectorType::value_type ValueType;
+
+			static const ValueType* tag() { return 0; }
+
+			SomeVectorType* x_;
+			size_t n_;
+			const SymmetricCrsMatrix& matrix_;
+		}; // class ReduceHelper
+
+	public:
+
+		SymmetricCrsMatrix(size_t threads)
+		: threads_((threads==0) ? 1 : threads)
+		{}
+
+		//! To be filled with the diagonal and upper triangle, then update()
+		SparseMatrixType& matrix() { return upper_; }
+
+		const SparseMatrixType& matrix() const { return upper_; }
+
+		/*! Partitions the rows and allocates the buffers of the threads;
+		 *  entries below the diagonal, if any, are dropped in place
+		 */
+		void update()
+		{
+			size_t rows = upper_.row();
+			if (rows>0) {
+				size_t counter = 0;
+				int begin = upper_.getRowPtr(0);
+				for (size_t i=0;i<rows;i++) {
+					int end = upper_.getRowPtr(i+1);
+					upper_.setRow(i,counter);
+					for (int k=begin;k<end;k++) {
+						if (size_t(upper_.getCol(k))<i) continue;
+						upper_.setCol(counter,upper_.getCol(k));
+						upper_.setValues(counter,upper_.getValue(k));
+						counter++;
+					}
+					begin = end;
+				}
+				upper_.setRow(rows,counter);
+			}
+
+			rowPartition(partition_,upper_,rows,threads_);
+			realBuffers_.clear();
+			complexBuffers_.clear();
+			reserveBuffers(1,static_cast<const FieldType*>(0));
+		}
+
+		size_t rank() const { return upper_.row(); }
+
+		size_t nonZero() const
+		{
+			return (rank()==0) ? 0 : upper_.getRowPtr(rank());
+		}
+
+		//! Thread t computes rows [bounds[t],bounds[t+1])
+		void rowBounds(std::vector<size_t>& bounds) const { bounds = partition_; }
+
+		//! Puts the rows of each thread on its NUMA node, see NumaPlacement.h
+		void numaPlace() const
+		{
+			NumaPlacement::placeCrs("SymmetricCRS",upper_,partition_);
+		}
+
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x, SomeVectorType const &y) const
+		{
+			assert(x.size()==rank() && y.size()==rank());
+			if (threads_==1) return product(x,0,y,0,rank());
+
+			product(&x,&y,1);
+		}
+
+		//! x[v] += H y[v] for all v, reading H only once
+		template<typename SomeVectorType>
+		void matrixVectorProductBlock(std::vector<SomeVectorType>& x,
+		                              const std::vector<SomeVectorType>& y) const
+		{
+			assert(x.size()==y.size());
+			if (x.size()==0) return;
+			if (threads_==1) {
+				for (size_t i=0;i<rank();i++)
+					for (size_t v=0;v<x.size();v++)
+						rowProduct(x[v],0,y[v],i);
+				return;
+			}
+
+			product(&x[0],&y[0],x.size());
+		}
+
+	private:
+
+		template<typename SomeVectorType>
+		void product(SomeVectorType* x,const SomeVectorType* y,size_t n) const
+		{
+			reserveBuffers(n,static_cast<const typename SomeVectorType::value_type*>(0));
+
+			typedef ProductHelper<SomeVectorType> ProductHelperType;
+			ProductHelperType productHelper(y,n,*this);
+			Parallelizer<ProductHelperType> productParallelizer(threads_);
+			productParallelizer.loopCreate(productHelper);
+
+			typedef ReduceHelper<SomeVectorType> ReduceHelperType;
+			ReduceHelperType reduceHelper(x,n,*this);
+			Parallelizer<ReduceHelperType> reduceParallelizer(threads_);
+			reduceParallelizer.loopCreate(reduceHelper);
+		}
+
+		// the buffers of n vectors of type T, kept for later products
+		template<typename T>
+		void reserveBuffers(size_t n,const T* tag) const
+		{
+			std::vector<std::vector<T> >& all = buffers(tag);
+			if (threads_==1 || all.size()>=n*threads_) return;
+			size_t v = all.size()/threads_;
+			all.resize(n*threads_);
+			for (;v<n;v++)
+				for (size_t t=0;t<threads_;t++)
+					buffer(t,v,tag).resize(rank()-partition_[t]);
+		}
+
+		template<typename T>
+		std::vector<T>& buffer(size_t threadNum,size_t v,const T* tag) const
+		{
+			return buffers(tag)[v*threads_+threadNum];
+		}
+
+		std::vector<std::vector<RealType> >& buffers(const RealType*) const
+		{
+			return realBuffers_;
+		}
+
+		std::vector<std::vector<ComplexType> >& buffers(const ComplexType*) const
+		{
+			return complexBuffers_;
+		}
+
+		// x[i-offset] += H(i,j)*y[j] for rows in [start,end), both triangles
+		template<typename SomeVectorType>
+		void product(SomeVectorType& x,
+		             size_t offset,
+		             const SomeVectorType& y,
+		             size_t start,
+		             size_t end) const
+		{
+			for (size_t i=start;i<end;i++) rowProduct(x,offset,y,i);
+		}
+
+		template<typename SomeVectorType,typename OtherVectorType>
+		void rowProduct(SomeVectorType& x,
+		                size_t offset,
+		                const OtherVectorType& y,
+		                size_t i) const
+		{
+			typename SomeVectorType::value_type sum = 0;
+			typename SomeVectorType::value_type yi = y[i];
+			for (int k=upper_.getRowPtr(i);k<upper_.getRowPtr(i+1);k++) {
+				size_t col = upper_.getCol(k);
+				const FieldType& value = upper_.getValue(k);
+				sum += value*y[col];
+				if (col!=i) x[col-offset] += conjugate(value)*yi;
+			}
+			x[i-offset] += sum;
+		}
+
+		template<typename T>
+		static T conjugate(const T& value) { return value; }
+
+		template<typename T>
+		static std::complex<T> conjugate(const std::complex<T>& value)
+		{
+			return std::conj(value);
+		}
+
+		size_t threads_;
+		SparseMatrixType upper_;
+		std::vector<size_t> partition_;
+		mutable std::vector<std::vector<RealType> > realBuffers_;
+		mutable std::vector<std::vector<ComplexType> > complexBuffers_;
+	}; // class SymmetricCrsMatrix
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SYMMETRIC_CRS_MATRIX_H
@@ -0,0 +1,257 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file SymmetryBlockBuilder.h
+ *
+ *  Builds the Hamiltonian of each sector of a symmetry directly, one
+ *  sector at a time, without the Hamiltonian in the whole basis
+ *
+ *  Row a of a sector is the state U(a,t)=chi(g)/sqrt(d) for each state
+ *  t=g|r> of the orbit of its representative |r>, with d states in the
+ *  orbit. If H commutes with the group then
+ *  <a|H|b> = sqrt(d_a) sum_t H(r_a,t) conj(U(b,t))
+ *  so each row takes one fillRow() of the model, for r_a. The symmetry
+ *  provides, for each sector s, symmetry.sector(s), with
+ *  size(), the number of rows;
+ *  state(a), the index of r_a in the basis;
+ *  weight(a), sqrt(d_a);
+ *  column(t,b,value), which sets b and value=conj(U(b,t)) and returns
+ *  true, or returns false if the orbit of t has no state in the sector.
+ *  Rows are counted and then filled, split among threads, as in
+ *  HamiltonianBuilder.h; entries that cancel are not stored, nor are
+ *  those below the diagonal of blocks that are upperOnly()
+ *
+ */
+#ifndef SYMMETRY_BLOCK_BUILDER_H
+#define SYMMETRY_BLOCK_BUILDER_H
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include "CrsMatrix.h"
+#include "Parallelizer.h"
+#include "SparseRowBuffer.h"
+
+namespace LanczosPlusPlus {
+
+	template<typename ModelType,typename SymmetryType>
+	class SymmetryBlockBuilder {
+
+	public:
+
+		typedef typename ModelType::RealType RealType;
+		typedef typename ModelType::BasisType BasisType;
+		typedef typename SymmetryType::MatrixStoredType MatrixStoredType;
+		typedef typename SymmetryType::SectorType SectorType;
+		typedef typename SymmetryType::VectorType::value_type FieldType;
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+		typedef SparseRowBuffer<RealType> SparseRowType;
+		typedef SparseRowBuffer<FieldType> BlockRowType;
+
+	private:
+
+		// the row of H and the row of the block of each thread
+		struct RowBuffers {
+			SparseRowType row;
+			BlockRowType blockRow;
+		};
+
+		class CountHelper {
+
+		public:
+
+			CountHelper(const SymmetryBlockBuilder& builder,
+			            const SectorType& sector,
+			            bool upperOnly,
+			            std::vector<RowBuffers>& rows,
+			            std::vector<size_t>& nonZeros)
+			: builder_(builder),sector_(sector),upperOnly_(upperOnly),rows_(rows),nonZeros_(nonZeros)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				RowBuffers& buffers = rows_[threadNum];
+				size_t total = sector_.size();
+				size_t end = (total*(threadNum+1))/threads;
+				for (size_t a=(total*threadNum)/threads;a<end;a++)
+					nonZeros_[a] = builder_.fillRow(buffers,sector_,a,upperOnly_);
+			}
+
+		private:
+
+			const SymmetryBlockBuilder& builder_;
+			const SectorType& sector_;
+			bool upperOnly_;
+			std::vector<RowBuffers>& rows_;
+			std::vector<size_t>& nonZeros_;
+		}; // class CountHelper
+
+		class FillHelper {
+
+		public:
+
+			FillHelper(const SymmetryBlockBuilder& builder,
+			           const SectorType& sector,
+			           bool upperOnly,
+			           std::vector<RowBuffers>& rows,
+			           SparseMatrixType& matrix)
+			: builder_(builder),sector_(sector),upperOnly_(upperOnly),rows_(rows),matrix_(matrix)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				RowBuffers& buffers = rows_[threadNum];
+				const BlockRowType& blockRow = buffers.blockRow;
+				size_t total = sector_.size();
+				size_t end = (total*(threadNum+1))/threads;
+				for (size_t a=(total*threadNum)/threads;a<end;a++) {
+					builder_.fillRow(buffers,sector_,a,upperOnly_);
+					size_t offset = matrix_.getRowPtr(a);
+					size_t counter = 0;
+					for (size_t k=0;k<blockRow.size();k++) {
+						if (isAlmostZero(blockRow.value(k))) continue;
+						matrix_.setCol(offset+counter,blockRow.col(k));
+						matrix_.setValues(offset+counter,blockRow.value(k));
+						counter++;
+					}
+					assert(offset+counter==size_t(matrix_.getRowPtr(a+1)));
+				}
+			}
+
+		private:
+
+			const SymmetryBlockBuilder& builder_;
+			const SectorType& sector_;
+			bool upperOnly_;
+			std::vector<RowBuffers>& rows_;
+			SparseMatrixType& matrix_;
+		}; // class FillHelper
+
+	public:
+
+		SymmetryBlockBuilder(const ModelType& model,
+		                     const BasisType& basis,
+		                     const std::vector<RealType>& diag,
+		                     const SymmetryType& symmetry,
+		                     size_t threads)
+		: model_(model),
+		  basis_(basis),
+		  diag_(diag),
+		  symmetry_(symmetry),
+		  threads_((threads==0) ? 1 : threads)
+		{}
+
+		//! Fills and updates blocks[s] for each sector s that is not empty
+		void build(std::vector<MatrixStoredType>& blocks) const
+		{
+			assert(blocks.size()==symmetry_.sectors());
+			std::vector<RowBuffers> rows(threads_);
+			for (size_t t=0;t<threads_;t++) rows[t].row.reserveColumns(basis_.size());
+
+			for (size_t s=0;s<symmetry_.sectors();s++) {
+				SectorType sector = symmetry_.sector(s);
+				if (sector.size()==0) continue;
+				build(blocks[s].matrix(),sector,blocks[s].upperOnly(),rows);
+				blocks[s].update();
+			}
+		}
+
+	private:
+
+		void build(SparseMatrixType& matrix,
+		           const SectorType& sector,
+		           bool upperOnly,
+		           std::vector<RowBuffers>& rows) const
+		{
+			size_t rank = sector.size();
+			for (size_t t=0;t<threads_;t++) rows[t].blockRow.reserveColumns(rank);
+			std::vector<size_t> nonZeros(rank,0);
+
+			CountHelper countHelper(*this,sector,upperOnly,rows,nonZeros);
+			Parallelizer<CountHelper> countParallelizer(threads_);
+			countParallelizer.loopCreate(countHelper);
+
+			size_t total = 0;
+			for (size_t a=0;a<rank;a++) total += nonZeros[a];
+
+			matrix.resize(rank,rank,total);
+			size_t offset = 0;
+			for (size_t a=0;a<rank;a++) {
+				matrix.setRow(a,offset);
+				offset += nonZeros[a];
+			}
+			matrix.setRow(rank,offset);
+
+			FillHelper fillHelper(*this,sector,upperOnly,rows,matrix);
+			Parallelizer<FillHelper> fillParallelizer(threads_);
+			fillParallelizer.loopCreate(fillHelper);
+		}
+
+		// row a of the block into buffers.blockRow; returns its non-zeros
+		size_t fillRow(RowBuffers& buffers,
+		               const SectorType& sector,
+		               size_t a,
+		               bool upperOnly) const
+		{
+			SparseRowType& row = buffers.row;
+			BlockRowType& blockRow = buffers.blockRow;
+			row.clear();
+			model_.fillRow(row,sector.state(a),basis_,diag_);
+			row.finalize();
+
+			blockRow.clear();
+			RealType weight = sector.weight(a);
+			size_t b = 0;
+			FieldType value = 0;
+			for (size_t k=0;k<row.size();k++) {
+				if (!sector.column(row.col(k),b,value)) continue;
+				if (upperOnly && b<a) continue;
+				blockRow.add(b,weight*row.value(k)*value);
+			}
+			blockRow.finalize();
+
+			size_t nonZeros = 0;
+			for (size_t k=0;k<blockRow.size();k++)
+				if (!isAlmostZero(blockRow.value(k))) nonZeros++;
+			return nonZeros;
+		}
+
+		static bool isAlmostZero(const RealType& x)
+		{
+			return (fabs(x)<1e-10);
+		}
+
+		static bool isAlmostZero(const std::complex<RealType>& x)
+		{
+			return (std::abs(x)<1e-10);
+		}
+
+		const ModelType& model_;
+		const BasisType& basis_;
+		const std::vector<RealType>& diag_;
+		const SymmetryType& symmetry_;
+		size_t threads_;
+	}; // class SymmetryBlockBuilder
+} // namespace LanczosPlusPlus
+
+/*@}*/
+#endif // SYMMETRY_BLOCK_BUILDER_H
@@ -24,26 +24,30 @@ Please see full open source license included in file LICENSE.
 
 namespace LanczosPlusPlus {
 
-	template<typename GeometryType>
+	template<typename GeometryType,typename WordType_>
 	class BasisFeAsBasedSc {
 
-		static size_t orbitals_;
+		typedef FermionSign<WordType_> FermionSignType;
 
 	public:
 		
-		typedef BasisOneSpinFeAs BasisType;
-		typedef BasisType::WordType WordType;
+		typedef BasisOneSpinFeAs<WordType_> BasisType;
+		typedef typename BasisType::WordType WordType;
 		enum {SPIN_UP,SPIN_DOWN};
 //		static size_t const orbitals_  = BasisType::orbitals_;
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
 		
 		
-		BasisFeAsBasedSc(const GeometryType& geometry, size_t nup,size_t ndown,size_t orbitals)
-		: basis1_(geometry.numberOfSites(),nup,orbitals),
-		  basis2_(geometry.numberOfSites(),ndown,orbitals)
+		BasisFeAsBasedSc(const GeometryType& geometry,
+		                 size_t nup,
+		                 size_t ndown,
+		                 size_t orbitals,
+		                 size_t threads = 1)
+		: orbitals_(orbitals),
+		  basis1_(geometry.numberOfSites(),nup,orbitals,threads),
+		  basis2_(geometry.numberOfSites(),ndown,orbitals,threads)
 		{
-			orbitals_ = orbitals;
 //			std::cout<<"Basis1\n";
 //			std::cout<<basis1_;
 //			std::cout<<"Basis2\n";
@@ -51,10 +55,10 @@ namespace LanczosPlusPlus {
 		}
 		
 		BasisFeAsBasedSc(const GeometryType& geometry, size_t nup,size_t orbitals)
-		: basis1_(geometry.numberOfSites(),nup,orbitals),
+		: orbitals_(orbitals),
+		  basis1_(geometry.numberOfSites(),nup,orbitals),
 		  basis2_(geometry.numberOfSites(),nup,orbitals)
 		{
-			orbitals_ = orbitals;
 			std::string s = "BasisFeBasedSc::ctor(...): obsolete. ";
 			s+= "This probably means that you can't compute the Green function";
 			s+= " with this model (sorry). It might be added in the future.\n";
@@ -62,7 +66,7 @@ namespace LanczosPlusPlus {
 		}
 		
 
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
 			return BasisType::bitmask(i);
 		}
@@ -151,15 +155,15 @@ namespace LanczosPlusPlus {
 		{
 			if (spin==SPIN_UP) return basis1_.doSignGf(a,ind,orb);
 
-			int s=(PsimagLite::BitManip::count(a) & 1) ? -1 : 1; // Parity of up
+			int s = FermionSignType::sign(a); // Parity of up
 			int s2 = basis2_.doSignGf(b,ind,orb);
 
 			return s*s2;
 		}
 
 		size_t isThereAnElectronAt(
-				size_t ket1,
-				size_t ket2,
+				WordType ket1,
+				WordType ket2,
 				size_t site,
 				size_t spin,
 				size_t orb) const
@@ -207,12 +211,10 @@ namespace LanczosPlusPlus {
 						 basis2_.getBra(bra,ket2,what,site,orb);
 		}
 
+		size_t orbitals_;
 		BasisType basis1_,basis2_;
 	}; // class BasisFeAsBasedSc
 
-	template<typename GeometryType>
-	size_t BasisFeAsBasedSc<GeometryType>::orbitals_=2;
-
 } // namespace LanczosPlusPlus
 #endif
 
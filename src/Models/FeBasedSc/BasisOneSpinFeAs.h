@@ -20,35 +20,41 @@ Please see full open source license included in file LICENSE.
 
 #ifndef BASIS_ONE_SPIN_FE_AS_H
 #define BASIS_ONE_SPIN_FE_AS_H
-#include "Matrix.h"
-#include "BitManip.h"
+#include "BitWord.h"
+#include "Binomial.h"
+#include "Combinations.h"
+#include "FermionSign.h"
 #include "Partitions.h"
+#include <algorithm>
 
 namespace LanczosPlusPlus {
 	
+	template<typename WordType_>
 	class BasisOneSpinFeAs {
 
 		typedef Partitions PartitionsType;
+		typedef BitWord<WordType_> BitWordType;
+		typedef FermionSign<WordType_> FermionSignType;
 
 	public:
 		
-		typedef unsigned int long long WordType;
+		typedef WordType_ WordType;
 		enum {DESTRUCTOR,CONSTRUCTOR};
-		static size_t orbitals_;
 		static int const FERMION_SIGN  = -1;
-		static size_t nsite_;
-		static PsimagLite::Matrix<size_t> comb_;
-		static std::vector<WordType> bitmask_; 
 		
-		BasisOneSpinFeAs(size_t nsite, size_t npart,size_t orbitals)
-				: npart_(npart)
+		BasisOneSpinFeAs(size_t nsite, size_t npart,size_t orbitals,size_t threads = 1)
+				: orbitals_(orbitals),
+				  nsite_(nsite),
+				  npart_(npart),
+				  threads_(threads),
+				  comb_(orbitals*nsite),
+				  bmi2_(fermionSignBmi2())
 		{
-			if (nsite_>0 && nsite!=nsite_)
-				throw std::runtime_error("BasisOneSpinFeAs: All basis must have same number of sites\n");
-			orbitals_=orbitals;
-			nsite_ = nsite;
-			doCombinatorial();
-			doBitmask();
+			if (nsite*orbitals>size_t(BitWordType::BITS))
+				throw std::runtime_error("BasisOneSpinFeAs: too many orbitals for WordType\n");
+			doOrbitalMasks();
+			PartitionsType partitions(npart,orbitals_);
+			doRankTables(partitions);
 
 			/* compute size of basis */
 			if (npart==0) {
@@ -58,7 +64,6 @@ namespace LanczosPlusPlus {
 				return;
 			}
 			size_ = 0;
-			PartitionsType partitions(npart,orbitals_);
 			for (size_t i=0;i<partitions.size();i++) {
 					const std::vector<size_t>& na = partitions(i);
 					size_t tmp = 1;
@@ -68,6 +73,11 @@ namespace LanczosPlusPlus {
 			}
 			data_.resize(size_);
 
+			// kets of one orbital, by its number of electrons
+			std::vector<std::vector<WordType> > oneOrbital(npart+1);
+			for (size_t na=0;na<=npart;na++)
+				fillPartialBasis(oneOrbital[na],na);
+
 			// compute basis:
 			size_t counter = 0;
 
@@ -75,7 +85,7 @@ namespace LanczosPlusPlus {
 				const std::vector<size_t>& na = partitions(i);
 				std::vector<std::vector<WordType> > basisA(orbitals_);
 				for (size_t orb=0;orb<orbitals_;orb++) {
-					fillPartialBasis(basisA[orb],na[orb]);
+					basisA[orb] = oneOrbital[na[orb]];
 				}
 				collateBasis(counter,basisA);
 			}
@@ -88,48 +98,43 @@ namespace LanczosPlusPlus {
 			return data_[i];
 		}
 
+		/* States are ordered by partition na of the electrons among
+		 * orbitals (see Partitions), and then by
+		 * i_0 + i_1*S_0 + i_2*S_0*S_1 + ...
+		 * where i_orb is the rank of the ket of orbital orb and
+		 * S_orb = C^nsite_{na[orb]} (see getKets). So the index is the
+		 * offset of the partition plus that sum, in O(orbitals_*nsite_)
+		 */
 		size_t perfectIndex(WordType ket) const
 		{
-			for (size_t i=0;i<data_.size();i++)
-				if (data_[i]==ket) return i;
-			throw std::runtime_error("perfectindex\n");
+			size_t key = 0;
+			size_t power = 1;
+			size_t radix = 1;
+			size_t s = 0;
+			for (size_t orb=0;orb<orbitals_;orb++) {
+				WordType ketOrb = orbitalKet(ket,orb);
+				size_t na = BitWordType::count(ketOrb);
+				if (na>=partitionBase_) throw std::runtime_error("perfectindex\n");
+				s += perfectIndexPartial(ketOrb)*radix;
+				radix *= comb_(nsite_,na);
+				if (orb+1==orbitals_) break;
+				key += na*power;
+				power *= partitionBase_;
+			}
+			s += partitionOffset_[key];
+			if (s>=data_.size() || data_[s]!=ket) throw std::runtime_error("perfectindex\n");
+			return s;
 		}
 
-//			WordType ketA=0,ketB=0;
-//			uncollateKet(ketA,ketB,ket);
-//			// p(ket) = \sum_{na'=0}^{na'<na} S_na' * S_nb'
-//			//			+ p_A(ket_A)*S_nb + p_B(ket_B)
-//			// where S_x = C^n_x
-//			size_t na = PsimagLite::BitManip::count(ketA);
-//			// note nb = PsimagLite::BitManip::count(ketB)
-//			// or nb  = npart -na
-//			size_t s = 0;
-//			for (size_t nap=0;nap<na;nap++) {
-//				size_t nbp = npart_ - nap;
-//				s += comb_(nsite_,nap) * comb_(nsite_,nbp);
-//			}
-//			size_t nb = npart_ - na;
-//			s += perfectIndexPartial(ketA)*comb_(nsite_,nb);
-//			s += perfectIndexPartial(ketB);
-//			if (s>=data_.size())
-//				throw std::runtime_error("BasisOneSpinFeAs::PerfectIndex>=data_.size()\n");
-//			return s;
-//		}
-
 		size_t getN(WordType ket,size_t site,size_t orb) const
 		{
-			std::vector<WordType> kets(orbitals_,0);
-			uncollateKet(kets,ket);
-
-			WordType res = (kets[orb] & bitmask_[site]);
+			WordType res = (ket & bitmask(site*orbitals_+orb));
 			return (res>0) ? 1 : 0;
 		}
 
 		size_t getN(size_t i,size_t orb) const
 		{
-			std::vector<WordType> kets(orbitals_,0);
-			uncollateKet(kets,data_[i]);
-			return PsimagLite::BitManip::count(kets[orb]);
+			return BitWordType::count(data_[i] & orbitalMask_[orb]);
 		}
 
 		size_t getN(size_t i) const
@@ -142,34 +147,21 @@ namespace LanczosPlusPlus {
 
 		bool getBra(WordType& bra,const WordType& myword,size_t what,size_t site,size_t orb) const
 		{
-			std::vector<WordType> kets(orbitals_,0);
-			uncollateKet(kets,myword);
-
-			WordType braA = kets[orb];
-			if (!getBra(braA,kets[orb],what,site)) return false;
-
-			kets[orb] = braA;
-			bra = getCollatedKet(kets);
-			return true;
+			return getBra(bra,myword,what,site*orbitals_+orb);
 		}
 
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
-			return bitmask_[i];
+			return BitWordType::bit(i);
 		}
 
+		// Parity of the electrons of the orbitals below orb, and of
+		// orbital orb after site
 		int doSign(size_t i,size_t site,size_t orb) const
 		{
-			std::vector<WordType> kets(orbitals_,0);
-			uncollateKet(kets,data_[i]);
-
-			size_t c = 0;
-			for (size_t orb1=0;orb1<orb;orb1++) {
-				c += PsimagLite::BitManip::count(kets[orb1]);
-			}
-
-			int ret = (c&1) ? FERMION_SIGN : 1;
-			return ret * doSign(kets[orb],site);
+			WordType after = FermionSignType::rangeMask((site+1)*orbitals_,nsite_*orbitals_);
+			WordType mask = orbitalsBelowMask_[orb] | (orbitalMask_[orb] & after);
+			return FermionSignType::sign(data_[i] & mask);
 		}
 
 		int doSign(
@@ -185,39 +177,13 @@ namespace LanczosPlusPlus {
 				std::cerr<<"AT: "<<__FILE__<<" : "<<__LINE__<<std::endl;
 				throw std::runtime_error("FeBasedSc::doSign(...)\n");
 			}
-			size_t x0 = (i+1)*orbitals_; // i+1 cannot be the last site, 'cause i<j
-			size_t x1 = j*orbitals_;
-
-			size_t sum = getNbyKet(ket,x0,x1);
-
-			// at site i we need to be carefull
-			x0 = i*orbitals_+orb1;
-			x1 = (i+1)*orbitals_;
-			sum += getNbyKet(ket,x0,x1);
-
-			// same at site j
-			x0 = j*orbitals_;
-			x1 = j*orbitals_+orb2;
-			sum += getNbyKet(ket,x0,x1);
-
-			return (sum & 1) ? FERMION_SIGN : 1;
-		}
-
-		size_t getNbyKet(size_t ket) const
-		{
-			size_t sum = 0;
-			WordType ketCopy = ket;
-			while(ketCopy) {
-				if (ketCopy & 1) sum++;
-				ketCopy <<= 1;
-			}
-			return sum;
+			return FermionSignType::hopSign(ket,i,orb1,j,orb2,orbitals_);
 		}
 
-		size_t isThereAnElectronAt(size_t ket,size_t site,size_t orb) const
+		size_t isThereAnElectronAt(WordType ket,size_t site,size_t orb) const
 		{
 			size_t x = site*orbitals_ + orb;
-			return (ket & bitmask_[x]) ? 1 : 0;
+			return (ket & bitmask(x)) ? 1 : 0;
 		}
 
 		size_t electrons() const { return npart_; }
@@ -236,65 +202,20 @@ namespace LanczosPlusPlus {
 			return newPart1;
 		}
 
+		// Parity of the electrons of the orbitals below orb, and of
+		// orbital orb before site ind
 		int doSignGf(WordType a,size_t ind,size_t orb) const
 		{
-			std::vector<WordType> kets(orbitals_,0);
-			uncollateKet(kets,a);
-
-			size_t c = 0;
-			for (size_t orb1=0;orb1<orb;orb1++) {
-				c += PsimagLite::BitManip::count(kets[orb1]);
-			}
-			int ret = (c&1) ? FERMION_SIGN : 1;
-
-			return ret * doSignGf(kets[orb],ind);
+			WordType before = BitWordType::lowMask(ind*orbitals_);
+			WordType mask = orbitalsBelowMask_[orb] | (orbitalMask_[orb] & before);
+			return FermionSignType::sign(a & mask);
 		}
 
 	private:
 
-		int doSignGf(WordType b,size_t ind) const
+		void fillPartialBasis(std::vector<WordType>& partialBasis,size_t npart) const
 		{
-			if (ind==0) return 1;
-
-			// ind>0 from now on
-			size_t i = 0;
-			size_t j = ind;
-			WordType mask = b;
-			mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-			int s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-			// Is there a down at i?
-			if (bitmask_[i] & b) s = -s;
-			return s;
-		}
-
-		void fillPartialBasis(std::vector<WordType>& partialBasis,size_t npart)
-		{
-			/* compute size of basis */
-			size_t hilbert=1;
-			int n=nsite_;
-			size_t m=1;
-			for (;m<=npart;n--,m++)
-				hilbert=hilbert*n/m;
-
-			if (partialBasis.size()!=hilbert) {
-				partialBasis.clear();
-				partialBasis.resize(hilbert);
-			}
-
-			if (npart==0) {
-				partialBasis[0]=0;
-				return;
-			}
-			/* define basis states */
-			WordType ket = (1ul<<npart)-1;
-			for (size_t i=0;i<hilbert;i++) {
-				partialBasis[i] = ket;
-				n=m=0;
-				for (;(ket&3)!=1;n++,ket>>=1) {
-					m += ket&1;
-				}
-				ket = ((ket+1)<<n) ^ ((1<<m)-1);
-			}
+			Combinations<WordType>::fill(partialBasis,nsite_,npart,comb_,threads_);
 		}
 
 		void collateBasis(size_t& counter,const std::vector<std::vector<WordType> >& basisA)
@@ -330,31 +251,49 @@ namespace LanczosPlusPlus {
 			kets[0] = basisA[0][tmp];
 		}
 
-		void doCombinatorial()
+		// offset of each partition, by the electrons of all orbitals but the last
+		void doRankTables(const PartitionsType& partitions)
 		{
-			/* look-up table for binomial coefficients */
-			comb_.reset(orbitals_*nsite_+1,orbitals_*nsite_+1);
-
-			for (size_t n=0;n<comb_.n_row();n++)
-				for (size_t i=0;i<comb_.n_col();i++)
-					comb_(n,i)=0;
-
-			for (size_t n=0;n<comb_.n_row();n++) {
-				size_t m = 0;
-				int j = n;
-				size_t i = 1;
-				size_t cnm  = 1;
-				for (;m<=n/2;m++,cnm=cnm*j/i,i++,j--)
-					comb_(n,m) = comb_(n,n-m) = cnm;
+			partitionBase_ = std::min(nsite_,npart_) + 1;
+			size_t entries = 1;
+			for (size_t orb=0;orb+1<orbitals_;orb++) entries *= partitionBase_;
+			partitionOffset_.assign(entries,0);
+
+			size_t offset = 0;
+			for (size_t i=0;i<partitions.size();i++) {
+				const std::vector<size_t>& na = partitions(i);
+				size_t key = 0;
+				size_t power = 1;
+				size_t states = 1;
+				for (size_t orb=0;orb<orbitals_;orb++) {
+					states *= comb_(nsite_,na[orb]);
+					if (orb+1==orbitals_) break;
+					key += na[orb]*power;
+					power *= partitionBase_;
+				}
+				if (states==0) continue;
+				partitionOffset_[key] = offset;
+				offset += states;
 			}
 		}
 
-		void doBitmask()
+		// bits site*orbitals_+orb of orbital orb, and the bits of all orbitals below it
+		void doOrbitalMasks()
 		{
-			bitmask_.resize(nsite_*orbitals_*orbitals_+1);
-			bitmask_[0]=1ul;
-			for (size_t i=1;i<bitmask_.size();i++)
-				bitmask_[i] = bitmask_[i-1]<<1;
+			orbitalMask_.assign(orbitals_,0);
+			orbitalsBelowMask_.assign(orbitals_,0);
+			for (size_t orb=0;orb<orbitals_;orb++) {
+				for (size_t site=0;site<nsite_;site++)
+					orbitalMask_[orb] |= bitmask(site*orbitals_+orb);
+				if (orb+1<orbitals_)
+					orbitalsBelowMask_[orb+1] = orbitalsBelowMask_[orb] | orbitalMask_[orb];
+			}
+		}
+
+		// bit site of the result is bit site*orbitals_+orb of ket
+		WordType orbitalKet(WordType ket,size_t orb) const
+		{
+			return FermionSignType::extract(ket,orbitalMask_[orb],bmi2_);
 		}
 
 		size_t perfectIndexPartial(WordType state) const
@@ -366,61 +305,28 @@ namespace LanczosPlusPlus {
 			return n;
 		}
 
+		// inverse of orbitalKet
 		WordType getCollatedKet(const std::vector<WordType>& kets) const
 		{
-			size_t counter = 0;
 			WordType ket = 0;
-
-			std::vector<WordType> remA = kets;
-
-			while( orAll(remA) ) {
-				for (size_t orb=0;orb<kets.size();orb++) {
-					size_t bitA = (remA[orb] & 1);
-					if (bitA) ket |=bitmask_[counter];
-					counter++;
-					if (remA[orb]) remA[orb] >>= 1;
-				}
-			}
+			for (size_t orb=0;orb<kets.size();orb++)
+				ket |= FermionSignType::deposit(kets[orb],orbitalMask_[orb],bmi2_);
 			return ket;
 		}
 
-		size_t orAll(const std::vector<WordType>& kets) const
-		{
-			size_t b = 0;
-			for (size_t orb=0;orb<kets.size();orb++) b |= kets[orb];
-			return b;
-		}
-
-		//! kets must be all zero here
-		void uncollateKet(std::vector<WordType>& kets,WordType ket) const
-		{
-			size_t counter = 0;
-
-			while(ket) {
-				for (size_t orb=0;orb<kets.size();orb++) {
-					size_t mask = (1<<orb);
-					size_t bitA = (ket & mask);
-
-					if (bitA) kets[orb] |= bitmask_[counter];
-				}
-				counter++;
-				ket >>= orbitals_;
-			}
-		}
-
 		bool getBra(WordType& bra, const WordType& ket,size_t what,size_t i) const
 		{
 
-			WordType si=(ket & bitmask_[i]);
+			WordType si=(ket & bitmask(i));
 			if (what==DESTRUCTOR) {
 				if (si>0) {
-					bra = (ket ^ bitmask_[i]);
+					bra = (ket ^ bitmask(i));
 				} else {
 					return false; // cannot destroy, there's nothing
 				}
 			} else {
 				if (si==0) {
-					bra = (ket ^ bitmask_[i]);
+					bra = (ket ^ bitmask(i));
 				} else {
 					return false; // cannot construct, there's already one
 				}
@@ -428,45 +334,32 @@ namespace LanczosPlusPlus {
 			return true;
 		}
 
-		int doSign(WordType a, size_t i) const
-		{
-			if (i==nsite_-1) return 1;
-
-			a &= ((1 << (i+1)) - 1) ^ ((1 << nsite_) - 1);
-			// Parity of single occupied between i and nsite-1
-			int s=(PsimagLite::BitManip::count(a) & 1) ? FERMION_SIGN : 1;
-			return s;
-		}
-
-		size_t getNbyKet(size_t ket,size_t from,size_t upto) const
-		{
-			size_t sum = 0;
-			size_t counter = from;
-			while(counter<upto) {
-				if (ket & bitmask_[counter]) sum++;
-				counter++;
-			}
-			return sum;
-		}
-
+		size_t orbitals_;
+		size_t nsite_;
 		size_t size_;
 		size_t npart_;
+		size_t threads_;
+		Binomial comb_;
 		std::vector<WordType> data_;
+		size_t partitionBase_;
+		std::vector<size_t> partitionOffset_;
+		bool bmi2_;
+		std::vector<WordType> orbitalMask_;
+		std::vector<WordType> orbitalsBelowMask_;
 
 	}; // class BasisOneSpinFeAs
 
-	std::ostream& operator<<(std::ostream& os,const BasisOneSpinFeAs& b)
+	template<typename WordType_>
+	std::ostream& operator<<(std::ostream& os,const BasisOneSpinFeAs<WordType_>& b)
 	{
-		for (size_t i=0;i<b.size();i++)
-			os<<i<<" "<<b[i]<<"\n";
+		for (size_t i=0;i<b.size();i++) {
+			os<<i<<" ";
+			BitWord<WordType_>::print(os,b[i]);
+			os<<"\n";
+		}
 		return os;
 	}
 
-	size_t BasisOneSpinFeAs::orbitals_=2;
-	size_t BasisOneSpinFeAs::nsite_=0;
-	PsimagLite::Matrix<size_t> BasisOneSpinFeAs::comb_;
-	std::vector<BasisOneSpinFeAs::WordType> BasisOneSpinFeAs::bitmask_;
-
 } // namespace LanczosPlusPlus
 #endif
 
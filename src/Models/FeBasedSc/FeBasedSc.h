@@ -23,34 +23,50 @@ Please see full open source license included in file LICENSE.
 
 #include "CrsMatrix.h"
 #include "BasisFeAsBasedSc.h"
-#include "SparseRow.h"
 #include "ParametersModelFeAs.h"
+#include "HamiltonianBuilder.h"
+#include "SymmetryBlockBuilder.h"
 
 namespace LanczosPlusPlus {
 	
-	template<typename RealType_,typename GeometryType_>
+	template<typename RealType_,typename GeometryType_,typename WordType_=unsigned long long>
 	class FeBasedSc {
 		
 		typedef PsimagLite::Matrix<RealType_> MatrixType;
+		typedef BitWord<WordType_> BitWordType;
 
 	public:
 
 		typedef ParametersModelFeAs<RealType_> ParametersModelType;
 		typedef GeometryType_ GeometryType;
-		typedef BasisFeAsBasedSc<GeometryType> BasisType;
+		typedef BasisFeAsBasedSc<GeometryType,WordType_> BasisType;
 		typedef typename BasisType::WordType WordType;
 		typedef RealType_ RealType;
 		typedef PsimagLite::CrsMatrix<RealType> SparseMatrixType;
-		typedef PsimagLite::SparseRow<SparseMatrixType> SparseRowType;
+		typedef SparseRowBuffer<RealType> SparseRowType;
 		typedef std::vector<RealType> VectorType;
+
+		// What the on-the-fly product needs for one basis
+		struct OnTheFlyDataType {
+			OnTheFlyDataType() : basis(0) {}
+
+			const BasisType* basis;
+			std::vector<RealType> diag;
+		};
 		enum {SPIN_UP=BasisType::SPIN_UP,SPIN_DOWN=BasisType::SPIN_DOWN};
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
+		// setupOnTheFly and matrixVectorProduct, see InternalProductOnTheFly.h
+		enum {HAS_ON_THE_FLY=1};
 		enum {TERM_HOPPINGS=0,TERM_J=1};
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 		
 		
-		FeBasedSc(size_t nup,size_t ndown,const ParametersModelType& mp,const GeometryType& geometry)
-		: mp_(mp),geometry_(geometry),basis_(geometry,nup,ndown,mp_.orbitals)
+		FeBasedSc(size_t nup,
+		          size_t ndown,
+		          const ParametersModelType& mp,
+		          const GeometryType& geometry,
+		          size_t threads = 1)
+		: mp_(mp),geometry_(geometry),basis_(geometry,nup,ndown,mp_.orbitals,threads)
 		{
 		}
 		
@@ -66,6 +82,12 @@ namespace LanczosPlusPlus {
 			setupHamiltonian(matrix,basis_);
 		}
 		
+		//! A basis of this model with nup and ndown electrons, see SectorCache.h
+		BasisType* newBasis(size_t nup,size_t ndown,size_t threads) const
+		{
+			return new BasisType(geometry_,nup,ndown,mp_.orbitals,threads);
+		}
+
 		bool hasNewParts(std::pair<size_t,size_t>& newParts,
 						 size_t what2,
 						 size_t type,
@@ -94,69 +116,86 @@ namespace LanczosPlusPlus {
 		const GeometryType& geometry() const { return geometry_; }
 
 		void setupHamiltonian(SparseMatrixType &matrix,
-				      const BasisType &basis) const
+				      const BasisType &basis,
+				      size_t threads = 1,
+				      bool upperOnly = false) const
 		{
-			// Calculate diagonal elements AND count non-zero matrix elements
-			size_t hilbert=basis.size();
-			std::vector<RealType> diag(hilbert);
+			std::vector<RealType> diag(basis.size());
 			calcDiagonalElements(diag,basis);
 
-			size_t nsite = geometry_.numberOfSites();
+			HamiltonianBuilder<FeBasedSc> builder(*this,basis,diag,threads,upperOnly);
+			builder.build(matrix);
+		}
 
-			// Setup CRS matrix
-			matrix.resize(hilbert,hilbert);
+		//! The Hamiltonian in each sector of symmetry, see SymmetryBlockBuilder.h
+		template<typename SymmetryType>
+		void setupHamiltonian(std::vector<typename SymmetryType::MatrixStoredType>& blocks,
+		                      const BasisType &basis,
+		                      const SymmetryType& symmetry,
+		                      size_t threads) const
+		{
+			std::vector<RealType> diag(basis.size());
+			calcDiagonalElements(diag,basis);
 
-			// Calculate off-diagonal elements AND store matrix
-			size_t nCounter=0;
-			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				SparseRowType sparseRow;
-				matrix.setRow(ispace,nCounter);
-				WordType ket1 = basis(ispace,SPIN_UP);
-				WordType ket2 = basis(ispace,SPIN_DOWN);
-				// Save diagonal
-				sparseRow.add(ispace,diag[ispace]);
-				for (size_t i=0;i<nsite;i++) {
-					for (size_t orb=0;orb<mp_.orbitals;orb++) {
-						setHoppingTerm(sparseRow,ket1,ket2,
-								i,orb,basis);
+			SymmetryBlockBuilder<FeBasedSc,SymmetryType> builder(*this,basis,diag,symmetry,threads);
+			builder.build(blocks);
+		}
 
-						setU2OffDiagonalTerm(sparseRow,ket1,ket2,
+		//! Adds the entries of row ispace, called by HamiltonianBuilder and SymmetryBlockBuilder
+		void fillRow(SparseRowType& sparseRow,
+			     size_t ispace,
+			     const BasisType& basis,
+			     const std::vector<RealType>& diag) const
+		{
+			size_t nsite = geometry_.numberOfSites();
+			WordType ket1 = basis(ispace,SPIN_UP);
+			WordType ket2 = basis(ispace,SPIN_DOWN);
+			// Save diagonal
+			sparseRow.add(ispace,diag[ispace]);
+			for (size_t i=0;i<nsite;i++) {
+				for (size_t orb=0;orb<mp_.orbitals;orb++) {
+					setHoppingTerm(sparseRow,ket1,ket2,
 							i,orb,basis);
-						for (size_t orb2=0;orb2<mp_.orbitals;orb2++) {
-							if (orb==orb2) continue;
 
-							setU3Term(sparseRow,ket1,ket2,
-									  i,orb,orb2,basis);
-						}
+					setU2OffDiagonalTerm(sparseRow,ket1,ket2,
+						i,orb,basis);
+					for (size_t orb2=0;orb2<mp_.orbitals;orb2++) {
+						if (orb==orb2) continue;
 
-						setJTermOffDiagonal(sparseRow,ket1,ket2,
-								i,orb,basis);
+						setU3Term(sparseRow,ket1,ket2,
+								  i,orb,orb2,basis);
 					}
+
+					setJTermOffDiagonal(sparseRow,ket1,ket2,
+							i,orb,basis);
 				}
-				nCounter += sparseRow.finalize(matrix);
 			}
-			matrix.setRow(hilbert,nCounter);
 		}
 
-		void matrixVectorProduct(VectorType &x,const VectorType& y) const
+		//! Builds what matrixVectorProduct needs for basis, once per basis
+		void setupOnTheFly(OnTheFlyDataType& data,const BasisType& basis) const
 		{
-			matrixVectorProduct(x,y,&basis_);
+			data.basis = &basis;
+			data.diag.resize(basis.size());
+			calcDiagonalElements(data.diag,basis);
 		}
 
 		void matrixVectorProduct(VectorType &x,
 					  const VectorType& y,
-					  const BasisType* basis) const
+					  const OnTheFlyDataType& data) const
 		{
-			// Calculate diagonal elements AND count non-zero matrix elements
+			const BasisType* basis = data.basis;
 			size_t hilbert=basis->size();
-			calcDiagonalElements(x,y,basis);
+			for (size_t ispace=0;ispace<hilbert;ispace++)
+				x[ispace] += data.diag[ispace]*y[ispace];
 
 			size_t nsite = geometry_.numberOfSites();
 
 			// Calculate off-diagonal elements AND store matrix
-
+			SparseRowType sparseRow;
+			sparseRow.reserveColumns(hilbert);
 			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				SparseRowType sparseRow;
+				sparseRow.clear();
 
 				WordType ket1 = basis->operator ()(ispace,SPIN_UP);
 				WordType ket2 = basis->operator ()(ispace,SPIN_DOWN);
@@ -178,7 +217,7 @@ namespace LanczosPlusPlus {
 								i,orb,*basis);
 					}
 				}
-				x[ispace] += sparseRow.finalize(y);
+				x[ispace] += sparseRow.matrixVectorProduct(y);
 			}
 		}
 
@@ -206,7 +245,7 @@ namespace LanczosPlusPlus {
 					s += "\n";
 					s += "what=" + ttos(what) + " spin=" + ttos(spin);
 					s += " site=" + ttos(site);
-					s += "ket1=" + ttos(ket1) + " and ket2=" + ttos(ket2);
+					s += "ket1=" + BitWordType::toString(ket1) + " and ket2=" + BitWordType::toString(ket2);
 					s += "\n";
 					s += "getModifiedState: z.size=" + ttos(z.size());
 					s += " but temp=" + ttos(temp) + "\n";
@@ -389,20 +428,6 @@ namespace LanczosPlusPlus {
 			}
 		}
 
-		void calcDiagonalElements(VectorType &x,
-					  const VectorType& y,
-					  const BasisType* basis) const
-		{
-			size_t hilbert=basis->size();
-			size_t nsite = geometry_.numberOfSites();
-
-			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				WordType ket1 = basis->operator()(ispace,SPIN_UP);
-				WordType ket2 = basis->operator()(ispace,SPIN_DOWN);
-				x[ispace] += findS(nsite,ket1,ket2,ispace,*basis)*y[ispace];
-			}
-		}
-
 		RealType findS(size_t nsite,WordType ket1,WordType ket2,size_t ispace,const BasisType& basis) const
 		{
 			RealType s = 0;
@@ -8,11 +8,14 @@
 
 namespace LanczosPlusPlus {
 	
-	template<typename GeometryType>
+	template<typename GeometryType,typename WordType_>
 	class BasisHubbardLanczos {
+
+		typedef FermionSign<WordType_> FermionSignType;
+
 	public:
 		
-		typedef BasisOneSpin BasisType;
+		typedef BasisOneSpin<WordType_> BasisType;
 		typedef typename BasisType::WordType WordType;
 
 		enum {SPIN_UP,SPIN_DOWN};
@@ -21,18 +24,27 @@ namespace LanczosPlusPlus {
 
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 
-		BasisHubbardLanczos(const GeometryType& geometry, size_t nup,size_t ndown) 
-		: basis1_(geometry.numberOfSites(),nup),
-		  basis2_(geometry.numberOfSites(),ndown)
+		BasisHubbardLanczos(const GeometryType& geometry,
+		                    size_t nup,
+		                    size_t ndown,
+		                    size_t threads = 1)
+		: basis1_(geometry.numberOfSites(),nup,threads),
+		  basis2_(geometry.numberOfSites(),ndown,threads)
 		{} 
 		
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
 			return BasisType::bitmask(i);
 		}
 
 		size_t size() const { return basis1_.size()*basis2_.size(); }
 
+		//! The basis of one spin species; states are up + down*size(SPIN_UP)
+		const BasisType& oneSpin(size_t spin) const
+		{
+			return (spin==SPIN_UP) ? basis1_ : basis2_;
+		}
+
 		//! Spin up and spin down
 		size_t dofs() const { return 2; }
 
@@ -75,33 +87,11 @@ namespace LanczosPlusPlus {
 			return (spin==SPIN_UP) ? basis1_.getN(ket1,site) : basis2_.getN(ket2,site);
 		}
 		
+		// Parity of the electrons before site ind; downs come after all ups
 		int doSignGf(WordType a, WordType b,size_t ind,size_t sector) const
 		{
-			if (sector==SPIN_UP) {
-				if (ind==0) return 1;
-
-				// ind>0 from now on
-				size_t i = 0;
-				size_t j = ind;
-				WordType mask = a;
-				mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-				int s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-				// Is there an up at i?
-				if (BasisType::bitmask(i) & a) s = -s;
-				return s;
-			}
-			int s=(PsimagLite::BitManip::count(a) & 1) ? -1 : 1; // Parity of up
-			if (ind==0) return s;
-
-			// ind>0 from now on
-			size_t i = 0;
-			size_t j = ind;
-			WordType mask = b;
-			mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-			s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-			// Is there a down at i?
-			if (BasisType::bitmask(i) & b) s = -s;
-			return s;
+			if (sector==SPIN_UP) return FermionSignType::signBetween(a,0,ind);
+			return FermionSignType::sign(a) * FermionSignType::signBetween(b,0,ind);
 		}
 
 		int doSign(WordType ket1,
@@ -4,61 +4,34 @@
 
 #ifndef BASIS_ONE_SPIN_H
 #define BASIS_ONE_SPIN_H
-#include "Matrix.h"
-#include "BitManip.h"
+#include "BitWord.h"
+#include "Binomial.h"
+#include "Combinations.h"
+#include "FermionSign.h"
 
 namespace LanczosPlusPlus {
 	
+	template<typename WordType_>
 	class BasisOneSpin {
 
+		typedef BitWord<WordType_> BitWordType;
+		typedef FermionSign<WordType_> FermionSignType;
+
 	public:
 		
 		static int const FERMION_SIGN  = -1;
-		typedef unsigned int long long WordType;
-		static size_t nsite_;
-		static PsimagLite::Matrix<size_t> comb_;
-		static std::vector<WordType> bitmask_; 
+		typedef WordType_ WordType;
 
 		enum {DESTRUCTOR,CONSTRUCTOR};
 
-		BasisOneSpin(size_t nsite, size_t npart) 
-		: npart_(npart)
+		BasisOneSpin(size_t nsite, size_t npart,size_t threads = 1)
+		: nsite_(nsite),npart_(npart),comb_(nsite)
 		{
-			if (nsite_>0 && nsite!=nsite_)
-				throw std::runtime_error("BasisOneSpin: All basis must have same number of sites\n");
-			nsite_ = nsite;
-			doCombinatorial();
-			doBitmask();
-
-			/* compute size of basis */
-			size_t hilbert=1;
-			int n=nsite;
-			size_t m=1;
-			for (;m<=npart;n--,m++)
-				hilbert=hilbert*n/m;
-
-			if (data_.size()!=hilbert) {
-				data_.clear();
-				data_.resize(hilbert);
-			}
-
-			if (npart==0) {
-				data_[0]=0;
-				size_ = 1;
-				return;
-			}
-			
-			/* define basis states */
-			WordType ket = (1ul<<npart)-1;
-			for (size_t i=0;i<hilbert;i++) {
-				data_[i] = ket;
-				n=m=0;
-				for (;(ket&3)!=1;n++,ket>>=1) {
-					m += ket&1;
-				}
-				ket = ((ket+1)<<n) ^ ((1<<m)-1);
-			}
-			size_ = hilbert;
+			if (nsite>size_t(BitWordType::BITS))
+				throw std::runtime_error("BasisOneSpin: too many sites for WordType\n");
+			doChunkRank();
+			Combinations<WordType>::fill(data_,nsite_,npart_,comb_,threads);
+			size_ = data_.size();
 		} 
 		
 
@@ -69,26 +42,36 @@ namespace LanczosPlusPlus {
 			return data_[i];
 		} 
 
+		/* The rank is the sum of C(b,c) over the set bits of state, with b
+		 * the position of the bit and c the number of set bits up to it.
+		 * The sum over each chunk of CHUNK_BITS bits is read from
+		 * chunkRank_, given the chunk, the bits set before it, and the
+		 * value of the chunk
+		 */
 		size_t perfectIndex(WordType state) const
 		{
 			size_t n=0;
-			for (size_t b=0,c=1;state>0;b++,state>>=1)
-				if (state&1) n += comb_(b,c++);
+			size_t c=0;
+			for (size_t k=0;state>0;k++,state>>=CHUNK_BITS) {
+				size_t chunk = BitWordType::low(state & CHUNK_MASK);
+				n += chunkRank_[((k*(nsite_+1) + c)<<CHUNK_BITS) + chunk];
+				c += BitWordType::count(chunk);
+			}
 
 			assert(n<data_.size());
 			return n;
 		} 
 
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
-			return bitmask_[i];
+			return BitWordType::bit(i);
 		}
 
 		size_t electrons() const { return npart_; }
 
 		size_t isThereAnElectronAt(WordType ket,size_t site) const
 		{
-			return (ket & bitmask_[site]) ? 1 : 0;
+			return (ket & bitmask(site)) ? 1 : 0;
 		}
 		
 		size_t getN(WordType ket,size_t site) const
@@ -96,50 +79,31 @@ namespace LanczosPlusPlus {
 			return isThereAnElectronAt(ket,site);
 		}
 
+		// Parity of the electrons after site i
 		int doSign(WordType a, size_t i) const
 		{
-			if (i==nsite_-1) return 1;
-
-			a &= ((1 << (i+1)) - 1) ^ ((1 << nsite_) - 1);
-			// Parity of single occupied between i and nsite-1
-			int s=(PsimagLite::BitManip::count(a) & 1) ? FERMION_SIGN : 1;
-			return s;
+			return FermionSignType::signBetween(a,i+1,nsite_);
 		}
 
 		int doSign(WordType ket,size_t i,size_t j) const
 		{
 			assert(i <= j);
-			size_t x0 = (i+1); // i+1 cannot be the last site, 'cause i<j
-			size_t x1 = j;
-
-			size_t sum = getNbyKet(ket,x0,x1);
-
-			// at site i we need to be carefull
-			x0 = i;
-			x1 = (i+1);
-			sum += getNbyKet(ket,x0,x1);
-
-			// same at site j
-			x0 = j;
-			x1 = j;
-			sum += getNbyKet(ket,x0,x1);
-
-			return (sum & 1) ? FERMION_SIGN : 1;
+			return FermionSignType::hopSign(ket,i,0,j,0,1);
 		}
 
 		bool getBra(WordType& bra, const WordType& ket,size_t what,size_t site) const
 		{
 
-			WordType si=(ket & bitmask_[site]);
+			WordType si=(ket & bitmask(site));
 			if (what==DESTRUCTOR) {
 				if (si>0) {
-					bra = (ket ^ bitmask_[site]);
+					bra = (ket ^ bitmask(site));
 				} else {
 					return false; // cannot destroy, there's nothing
 				}
 			} else {
 				if (si==0) {
-					bra = (ket ^ bitmask_[site]);
+					bra = (ket ^ bitmask(site));
 				} else {
 					return false; // cannot construct, there's already one
 				}
@@ -149,68 +113,39 @@ namespace LanczosPlusPlus {
 	
 	private:
 
-		size_t getNbyKet(size_t ket,size_t from,size_t upto) const
-		{
-			size_t sum = 0;
-			size_t counter = from;
-			while(counter<upto) {
-				if (ket & bitmask_[counter]) sum++;
-				counter++;
-			}
-			return sum;
-		}
+		enum {CHUNK_BITS=8,CHUNK_MASK=(1<<CHUNK_BITS)-1};
 
-// 		size_t getNbyKet(size_t ket) const
-// 		{
-// 			size_t sum = 0;
-// 			WordType ketCopy = ket;
-// 			while(ketCopy) {
-// 				if (ketCopy & 1) sum++;
-// 				ketCopy <<= 1;
-// 			}
-// 			return sum;
-// 		}
-
-		void doCombinatorial()
+		// for all chunks, bits set before the chunk, and chunk values
+		void doChunkRank()
 		{
-			/* look-up table for binomial coefficients */
-			comb_.reset(nsite_,nsite_);
-
-			for (size_t n=0;n<nsite_;n++)
-				for (size_t i=0;i<nsite_;i++)
-					comb_(n,i)=0;
-
-			for (size_t n=0;n<nsite_;n++) {
-				size_t m = 0;
-				int j = n;
-				size_t i = 1;
-				size_t cnm  = 1;
-				for (;m<=n/2;m++,cnm=cnm*j/i,i++,j--)
-					comb_(n,m) = comb_(n,n-m) = cnm;
+			size_t chunks = (nsite_ + CHUNK_BITS - 1)/CHUNK_BITS;
+			chunkRank_.resize((chunks*(nsite_+1))<<CHUNK_BITS);
+			for (size_t k=0;k<chunks;k++) {
+				for (size_t before=0;before<=nsite_;before++) {
+					for (size_t chunk=0;chunk<=CHUNK_MASK;chunk++) {
+						size_t n = 0;
+						size_t c = before + 1;
+						for (size_t j=0;j<CHUNK_BITS;j++) {
+							if (!(chunk & (1<<j))) continue;
+							size_t b = k*CHUNK_BITS + j;
+							if (b<nsite_ && c<=nsite_) n += comb_(b,c);
+							c++;
+						}
+						chunkRank_[((k*(nsite_+1) + before)<<CHUNK_BITS) + chunk] = n;
+					}
+				}
 			}
-		} 
+		}
 
-		void doBitmask()
-		{
-			bitmask_.resize(nsite_);
-			bitmask_[0]=1ul;
-			for (size_t i=1;i<nsite_;i++)
-				bitmask_[i] = bitmask_[i-1]<<1;
-		} 
-		
-		
 		size_t size_;
+		size_t nsite_;
 		size_t npart_;
+		Binomial comb_;
+		std::vector<size_t> chunkRank_;
 		std::vector<WordType> data_;
 		
 	}; // class BasisOneSpin
 
-	size_t BasisOneSpin::nsite_=0;
-
-	PsimagLite::Matrix<size_t> BasisOneSpin::comb_;
-
-	std::vector<BasisOneSpin::WordType> BasisOneSpin::bitmask_; 
-
 } // namespace LanczosPlusPlus
 #endif // BASIS_ONE_SPIN_H
 
@@ -7,25 +7,36 @@
 
 #include "CrsMatrix.h"
 #include "BasisHubbardLanczos.h"
-#include "BitManip.h"
+#include "BitWord.h"
 #include "TypeToString.h"
 #include "SparseRow.h"
 #include "ParametersModelHubbard.h"
+#include "HamiltonianBuilder.h"
+#include "SymmetryBlockBuilder.h"
 
 namespace LanczosPlusPlus {
 
-	template<typename RealType_,typename GeometryType_>
+	template<typename RealType_,typename GeometryType_,typename WordType_=unsigned long long>
 	class HubbardOneOrbital {
 
 		typedef PsimagLite::Matrix<RealType_> MatrixType;
+		typedef BitWord<WordType_> BitWordType;
+		typedef PsimagLite::CrsMatrix<RealType_> OneSpinMatrixType;
 
 	public:
 
+		// What the on-the-fly product needs for one basis: the hoppings
+		// of each spin in its own basis, and the diagonal
+		struct OnTheFlyDataType {
+			OneSpinMatrixType hoppings[2];
+			std::vector<RealType_> diag;
+		};
+
 		typedef ParametersModelHubbard<RealType_> ParametersModelType;
 		typedef GeometryType_ GeometryType;
 		typedef PsimagLite::CrsMatrix<RealType_> SparseMatrixType;
-		typedef PsimagLite::SparseRow<SparseMatrixType> SparseRowType;
-		typedef BasisHubbardLanczos<GeometryType> BasisType;
+		typedef SparseRowBuffer<RealType_> SparseRowType;
+		typedef BasisHubbardLanczos<GeometryType,WordType_> BasisType;
 		typedef typename BasisType::WordType WordType;
 		typedef RealType_ RealType;
 		typedef std::vector<RealType> VectorType;
@@ -34,15 +45,19 @@ namespace LanczosPlusPlus {
 
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
 
+		// setupOnTheFly and matrixVectorProduct, see InternalProductOnTheFly.h
+		enum {HAS_ON_THE_FLY=1};
+
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 
 		HubbardOneOrbital(size_t nup,
 		                  size_t ndown,
 						  const ParametersModelType& mp,
-						  const GeometryType& geometry)
+						  const GeometryType& geometry,
+						  size_t threads = 1)
 		: mp_(mp),
 		  geometry_(geometry),
-		  basis_(geometry,nup,ndown),
+		  basis_(geometry,nup,ndown,threads),
 		  hoppings_(geometry_.numberOfSites(),geometry_.numberOfSites())
 		{
 			size_t n = geometry_.numberOfSites();
@@ -75,30 +90,101 @@ namespace LanczosPlusPlus {
 
 		//! Gf. related functions below:
 		void setupHamiltonian(SparseMatrixType &matrix,
-		                      const BasisType &basis) const
+		                      const BasisType &basis,
+		                      size_t threads = 1,
+		                      bool upperOnly = false) const
 		{
-			size_t hilbert=basis.size();
-			std::vector<RealType> diag(hilbert);
+			std::vector<RealType> diag(basis.size());
+			calcDiagonalElements(diag,basis);
+
+			HamiltonianBuilder<HubbardOneOrbital> builder(*this,basis,diag,threads,upperOnly);
+			builder.build(matrix);
+		}
+
+		//! The Hamiltonian in each sector of symmetry, see SymmetryBlockBuilder.h
+		template<typename SymmetryType>
+		void setupHamiltonian(std::vector<typename SymmetryType::MatrixStoredType>& blocks,
+		                      const BasisType &basis,
+		                      const SymmetryType& symmetry,
+		                      size_t threads) const
+		{
+			std::vector<RealType> diag(basis.size());
 			calcDiagonalElements(diag,basis);
-			
+
+			SymmetryBlockBuilder<HubbardOneOrbital,SymmetryType> builder(*this,basis,diag,symmetry,threads);
+			builder.build(blocks);
+		}
+
+		//! Adds the entries of row ispace, called by HamiltonianBuilder and SymmetryBlockBuilder
+		void fillRow(SparseRowType& sparseRow,
+		             size_t ispace,
+		             const BasisType& basis,
+		             const std::vector<RealType>& diag) const
+		{
 			size_t nsite = geometry_.numberOfSites();
+			WordType ket1 = basis(ispace,SPIN_UP);
+			WordType ket2 = basis(ispace,SPIN_DOWN);
+			// Save diagonal
+			sparseRow.add(ispace,diag[ispace]);
+			for (size_t i=0;i<nsite;i++) {
+				setHoppingTerm(sparseRow,ket1,ket2,i,basis);
+			}
+		}
 
-			matrix.resize(hilbert,hilbert);
-			// Calculate off-diagonal elements AND store matrix
-			size_t nCounter=0;
-			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				SparseRowType sparseRow;
-				matrix.setRow(ispace,nCounter);
-				WordType ket1 = basis(ispace,SPIN_UP);
-				WordType ket2 = basis(ispace,SPIN_DOWN);
-				// Save diagonal
-				sparseRow.add(ispace,diag[ispace]);
-				for (size_t i=0;i<nsite;i++) {
-					setHoppingTerm(sparseRow,ket1,ket2,i,basis);
+		//! Builds what matrixVectorProduct needs for basis, once per basis
+		void setupOnTheFly(OnTheFlyDataType& data,const BasisType& basis) const
+		{
+			data.diag.resize(basis.size());
+			calcDiagonalElements(data.diag,basis);
+			setupOneSpinHoppings(data.hoppings[SPIN_UP],basis.oneSpin(SPIN_UP));
+			setupOneSpinHoppings(data.hoppings[SPIN_DOWN],basis.oneSpin(SPIN_DOWN));
+		}
+
+		//! x += H y with H = T_up x 1 + 1 x T_down + D, without storing H
+		template<typename SomeVectorType>
+		void matrixVectorProduct(SomeVectorType &x,
+		                         const SomeVectorType& y,
+		                         const OnTheFlyDataType& data) const
+		{
+			typedef typename SomeVectorType::value_type FieldType;
+
+			const OneSpinMatrixType& tup = data.hoppings[SPIN_UP];
+			const OneSpinMatrixType& tdown = data.hoppings[SPIN_DOWN];
+			size_t sizeUp = tup.row();
+			size_t sizeDown = tdown.row();
+			size_t hilbert = sizeUp*sizeDown;
+			assert(x.size()==hilbert && y.size()==hilbert);
+
+			for (size_t i=0;i<hilbert;i++)
+				x[i] += data.diag[i]*y[i];
+
+			// T_up acts on each block of fixed down index
+			for (size_t idown=0;idown<sizeDown;idown++) {
+				size_t offset = idown*sizeUp;
+				for (size_t iup=0;iup<sizeUp;iup++) {
+					FieldType sum = 0;
+					for (int k=tup.getRowPtr(iup);k<tup.getRowPtr(iup+1);k++)
+						sum += tup.getValue(k)*y[offset+tup.getCol(k)];
+					x[offset+iup] += sum;
 				}
-				nCounter += sparseRow.finalize(matrix);
 			}
-			matrix.setRow(hilbert,nCounter);
+
+			// T_down mixes whole blocks: one axpy of length sizeUp per non-zero
+			for (size_t idown=0;idown<sizeDown;idown++) {
+				size_t offset = idown*sizeUp;
+				for (int k=tdown.getRowPtr(idown);k<tdown.getRowPtr(idown+1);k++) {
+					RealType value = tdown.getValue(k);
+					size_t offset2 = tdown.getCol(k)*sizeUp;
+					for (size_t iup=0;iup<sizeUp;iup++)
+						x[offset+iup] += value*y[offset2+iup];
+				}
+			}
+		}
+
+		//! A basis of this model with nup and ndown electrons, see SectorCache.h
+		BasisType* newBasis(size_t nup,size_t ndown,size_t threads) const
+		{
+			return new BasisType(geometry_,nup,ndown,threads);
 		}
 
 		bool hasNewParts(std::pair<size_t,size_t>& newParts,
@@ -176,7 +262,7 @@ namespace LanczosPlusPlus {
 					s += "\n";
 					s += "what=" + ttos(what) + " spin=" + ttos(spin);
 					s += " site=" + ttos(site);
-					s += "ket1=" + ttos(ket1) + " and ket2=" + ttos(ket2);
+					s += "ket1=" + BitWordType::toString(ket1) + " and ket2=" + BitWordType::toString(ket2);
 					s += "\n";
 					s += "getModifiedState: z.size=" + ttos(z.size());
 					s += " but temp=" + ttos(temp) + "\n";
@@ -221,6 +307,35 @@ namespace LanczosPlusPlus {
 // 
 // 		}
 // 		
+		void setupOneSpinHoppings(OneSpinMatrixType& matrix,
+		                          const typename BasisType::BasisType& oneSpin) const
+		{
+			size_t hilbert = oneSpin.size();
+			size_t nsite = geometry_.numberOfSites();
+
+			matrix.resize(hilbert,hilbert);
+			size_t nCounter=0;
+			for (size_t ispace=0;ispace<hilbert;ispace++) {
+				PsimagLite::SparseRow<OneSpinMatrixType> sparseRow;
+				matrix.setRow(ispace,nCounter);
+				WordType ket = oneSpin[ispace];
+				for (size_t i=0;i<nsite;i++) {
+					WordType si = (ket & BasisType::bitmask(i)) ? 1 : 0;
+					for (size_t j=i+1;j<nsite;j++) {
+						RealType h = hoppings_(i,j);
+						if (h==0) continue;
+						WordType sj = (ket & BasisType::bitmask(j)) ? 1 : 0;
+						if (si+sj!=1) continue;
+						WordType bra = ket ^ (BasisType::bitmask(i)|BasisType::bitmask(j));
+						int extraSign = (si==1) ? FERMION_SIGN : 1;
+						sparseRow.add(oneSpin.perfectIndex(bra),h*extraSign*oneSpin.doSign(ket,i,j));
+					}
+				}
+				nCounter += sparseRow.finalize(matrix);
+			}
+			matrix.setRow(hilbert,nCounter);
+		}
+
 		void calcDiagonalElements(std::vector<RealType>& diag,
 		                          const BasisType &basis) const
 		{
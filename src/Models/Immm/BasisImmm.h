@@ -24,12 +24,15 @@ Please see full open source license included in file LICENSE.
 
 namespace LanczosPlusPlus {
 
-	template<typename GeometryType>
+	template<typename GeometryType,typename WordType_>
 	class BasisImmm {
+
+		typedef FermionSign<WordType_> FermionSignType;
+
 	public:
 
-		typedef BasisOneSpinImmm BasisType;
-		typedef BasisType::WordType WordType;
+		typedef BasisOneSpinImmm<WordType_> BasisType;
+		typedef typename BasisType::WordType WordType;
 
 		class OrbsPerSite : public std::vector<size_t> {
 
@@ -54,13 +57,13 @@ namespace LanczosPlusPlus {
 
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
 
-		BasisImmm(const GeometryType& geometry, size_t nup,size_t ndown)
+		BasisImmm(const GeometryType& geometry,size_t nup,size_t ndown,size_t threads = 1)
 		: orbsPerSite_(geometry),
-		  basis1_(orbsPerSite_,nup),
-		  basis2_(orbsPerSite_,ndown)
+		  basis1_(orbsPerSite_,nup,threads),
+		  basis2_(orbsPerSite_,ndown,threads)
 		{}
 
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
 			return BasisType::bitmask(i);
 		}
@@ -179,12 +182,12 @@ namespace LanczosPlusPlus {
 			if (spin==SPIN_UP) {
 				return basis1_.doSignGf(a,ind,orb);
 			}
-			int s=(PsimagLite::BitManip::count(a) & 1) ? -1 : 1; // Parity of up
+			int s = FermionSignType::sign(a); // Parity of up
 			return s*basis2_.doSignGf(b,ind,orb);
 		}
 
-		size_t isThereAnElectronAt(size_t ket1,
-		                           size_t ket2,
+		size_t isThereAnElectronAt(WordType ket1,
+		                           WordType ket2,
 		                           size_t site,
 		                           size_t spin,
 		                           size_t orb) const
@@ -20,38 +20,48 @@ Please see full open source license included in file LICENSE.
 
 #ifndef BASIS_ONE_SPIN_IMMM_H
 #define BASIS_ONE_SPIN_IMMM_H
-#include "Matrix.h"
-#include "BitManip.h"
+#include "BitWord.h"
+#include "Binomial.h"
+#include "Combinations.h"
+#include "FermionSign.h"
 #include <cassert>
 
 namespace LanczosPlusPlus {
 
+	template<typename WordType_>
 	class BasisOneSpinImmm {
 
+		typedef BitWord<WordType_> BitWordType;
+		typedef FermionSign<WordType_> FermionSignType;
+
 	public:
 		
-		typedef unsigned int long long WordType;
+		typedef WordType_ WordType;
 		
 		enum {DESTRUCTOR,CONSTRUCTOR};
 
 		// 		static size_t const ORBITALS  = 2;
 		static int const FERMION_SIGN  = -1;
-		static size_t nsite_;
-		static PsimagLite::Matrix<size_t> comb_;
-		static std::vector<WordType> bitmask_; 
 
-		BasisOneSpinImmm(const std::vector<size_t>& orbsPerSite, size_t npart)
-		: orbsPerSite_(orbsPerSite),npart_(npart)
+		BasisOneSpinImmm(const std::vector<size_t>& orbsPerSite,
+		                 size_t npart,
+		                 size_t threads = 1)
+		: orbsPerSite_(orbsPerSite),
+		  nsite_(orbsPerSite.size()),
+		  npart_(npart),
+		  threads_(threads),
+		  comb_(maxElectrons()),
+		  bmi2_(fermionSignBmi2()),
+		  maskA_(0),
+		  maskB_(0)
 		{
-			if (nsite_>0 && orbsPerSite.size()!=nsite_) {
-				std::string s =  
-					"BasisOneSpinImmm: All basis must have same number of sites\n";
-				throw std::runtime_error(s.c_str());
+			if (maxElectrons()>size_t(BitWordType::BITS))
+				throw std::runtime_error("BasisOneSpinImmm: too many orbitals for WordType\n");
+			for (size_t i=0;i<nsite_;i++) {
+				maskA_ |= bitmask(2*i);
+				maskB_ |= bitmask(2*i+1);
 			}
-
-			nsite_ = orbsPerSite.size();
-			doCombinatorial();
-			doBitmask();
+			doRankTables();
 
 			/* compute size of basis */
 			if (npart==0) {
@@ -64,20 +74,15 @@ namespace LanczosPlusPlus {
 				levels += orbsPerSite_[i];
 			size_t tmp = comb_(levels,npart);
 			data_.resize(tmp);
-			
-			levels = orbsPerSite_.size()*orbs();			
-			tmp = comb_(levels,npart);
-			reordering_.resize(tmp);
 
 			// compute basis:
 			size_t counter = 0;
-			size_t counter2 = 0;
 			for (size_t na=0;na<=npart;na++) {
 				size_t nb = npart - na;
 				std::vector<WordType> basisA, basisB;
 				fillPartialBasis(basisA,na);
 				fillPartialBasis(basisB,nb);
-				collateBasis(counter,counter2,basisA,basisB);
+				collateBasis(counter,basisA,basisB);
 			}
 // 			std::cerr<<" in ctor NPART="<<npart_<<"\n";
 // 			print(std::cout);
@@ -93,37 +98,31 @@ namespace LanczosPlusPlus {
 		void print(std::ostream& os) const
 		{
 			std::cerr<<"--------------npart="<<npart_<<"\n";
-			for (size_t i=0;i<data_.size();i++)
-				std::cerr<<data_[i]<<"\n";
+			for (size_t i=0;i<data_.size();i++) {
+				BitWordType::print(std::cerr,data_[i]);
+				std::cerr<<"\n";
+			}
 			std::cerr<<"--------------\n";
 		}
 
+		/* States are ordered by the number na of electrons in orbital 0,
+		 * then by ketA, then by ketB (see collateBasis), so
+		 * p(ket) = offset_[na] + p_A(ketA)*S_B(nb) + p_B(ketB)
+		 * where S_B(x) = C^{sites with 2 orbitals}_x, and p_B ranks ketB
+		 * among kets without orbital 1 on sites with only one orbital
+		 */
 		size_t perfectIndex(WordType ket) const
 		{
-			for (size_t i=0;i<data_.size();i++)
-				if (data_[i]==ket) return i;
-			print(std::cout);
-			assert(false);
-			return 0; 
-// 			WordType ketA=0,ketB=0;
-// 			uncollateKet(ketA,ketB,ket);
-// 			// p(ket) = \sum_{na'=0}^{na'<na} S_na' * S_nb'
-// 			//			+ p_A(ket_A)*S_nb + p_B(ket_B)
-// 			// where S_x = C^n_x
-// 			size_t na = PsimagLite::BitManip::count(ketA);
-// 			// note nb = PsimagLite::BitManip::count(ketB)
-// 			// or nb  = npart -na
-// 			size_t s = 0;
-// 			for (size_t nap=0;nap<na;nap++) {
-// 				size_t nbp = npart_ - nap;
-// 				s += comb_(nsite_,nap) * comb_(nsite_,nbp);
-// 			}
-// 			size_t nb = npart_ - na;
-// 			s += perfectIndexPartial(ketA)*comb_(nsite_,nb);
-// 			s += perfectIndexPartial(ketB);
-// 			assert(s<reordering_.size());
-// 			assert(reordering_[s]<data_.size());
-// 			return reordering_[s];
+			WordType ketA=0,ketB=0;
+			uncollateKet(ketA,ketB,ket);
+			size_t na = BitWordType::count(ketA);
+			assert(na<offset_.size());
+			size_t nb = npart_ - na;
+			size_t s = offset_[na];
+			s += perfectIndexPartial(ketA)*comb_(sitesWithTwoOrbitals(),nb);
+			s += perfectIndexPartialB(ketB);
+			assert(s<data_.size() && data_[s]==ket);
+			return s;
 		}
 
 		size_t getN(WordType ket,size_t site,size_t orb) const
@@ -131,10 +130,10 @@ namespace LanczosPlusPlus {
 			WordType ketA=0,ketB=0;
 			uncollateKet(ketA,ketB,ket);
 			if (orb==0) {
-				   WordType res = (ketA & bitmask_[site]);
+				   WordType res = (ketA & bitmask(site));
 				   return (res>0) ? 1 : 0;
 			}
-			WordType res2 = ketB & bitmask_[site];
+			WordType res2 = ketB & bitmask(site);
 			return (res2>0) ? 1 : 0;
 		}
 
@@ -142,8 +141,8 @@ namespace LanczosPlusPlus {
 		{
 			WordType ketA=0,ketB=0;
 			uncollateKet(ketA,ketB,data_[i]);
-			if (orb==0) return PsimagLite::BitManip::count(ketA);
-			return PsimagLite::BitManip::count(ketB);
+			if (orb==0) return BitWordType::count(ketA);
+			return BitWordType::count(ketB);
 		}
 
 		size_t getN(size_t i) const
@@ -155,9 +154,9 @@ namespace LanczosPlusPlus {
 			throw std::runtime_error("getN\n");
 		}
 
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
-			return bitmask_[i];
+			return BitWordType::bit(i);
 		}
 
 		int doSign(size_t i,size_t site,size_t orb) const
@@ -168,9 +167,7 @@ namespace LanczosPlusPlus {
 				return doSign(ketA,site);
 			}
 
-			size_t c = PsimagLite::BitManip::count(ketA);
-			int ret = (c&1) ? FERMION_SIGN : 1;
-			return ret * doSign(ketB,site);
+			return FermionSignType::sign(ketA) * doSign(ketB,site);
 		}
 
 		int doSign(
@@ -186,22 +183,7 @@ namespace LanczosPlusPlus {
 				std::cerr<<"AT: "<<__FILE__<<" : "<<__LINE__<<std::endl;
 				throw std::runtime_error("BasisOneSpinImmm::doSign(...)\n");
 			}
-			size_t x0 = (i+1)*orbs(); // i+1 cannot be the last site, 'cause i<j
-			size_t x1 = j*orbs();
-
-			size_t sum = getNbyKet(ket,x0,x1);
-
-			// at site i we need to be carefull
-			x0 = i*orbs()+orb1;
-			x1 = (i+1)*orbs();
-			sum += getNbyKet(ket,x0,x1);
-
-			// same at site j
-			x0 = j*orbs();
-			x1 = j*orbs()+orb2;
-			sum += getNbyKet(ket,x0,x1);
-
-			return (sum & 1) ? FERMION_SIGN : 1;
+			return FermionSignType::hopSign(ket,i,orb1,j,orb2,orbs());
 		}
 		
 		int doSignGf(WordType a,size_t ind,size_t orb) const
@@ -210,27 +192,15 @@ namespace LanczosPlusPlus {
 
 			uncollateKet(ketA,ketB,a);
 
-			if (orb==0) return doSignGf(ketA,ind);
-			int s=(PsimagLite::BitManip::count(ketA) & 1) ? -1 : 1; // Parity of a
+			if (orb==0) return FermionSignType::signBetween(ketA,0,ind);
 
-			return s * doSignGf(ketB,ind);
-		}
-
-		size_t getNbyKet(size_t ket) const
-		{
-			size_t sum = 0;
-			WordType ketCopy = ket;
-			while(ketCopy) {
-				if (ketCopy & 1) sum++;
-				ketCopy <<= 1;
-			}
-			return sum;
+			return FermionSignType::sign(ketA) * FermionSignType::signBetween(ketB,0,ind);
 		}
 
-		size_t isThereAnElectronAt(size_t ket,size_t site,size_t orb) const
+		size_t isThereAnElectronAt(WordType ket,size_t site,size_t orb) const
 		{
 			size_t x = site*orbs() + orb;
-			return (ket & bitmask_[x]) ? 1 : 0;
+			return (ket & bitmask(x)) ? 1 : 0;
 		}
 
 		size_t electrons() const { return npart_; }
@@ -270,16 +240,16 @@ namespace LanczosPlusPlus {
 		bool getBra(WordType& bra, const WordType& ket,size_t what,size_t i) const
 		{
 
-			WordType si=(ket & bitmask_[i]);
+			WordType si=(ket & bitmask(i));
 			if (what==DESTRUCTOR) {
 				if (si>0) {
-					bra = (ket ^ bitmask_[i]);
+					bra = (ket ^ bitmask(i));
 				} else {
 					return false; // cannot destroy, there's nothing
 				}
 			} else {
 				if (si==0) {
-					bra = (ket ^ bitmask_[i]);
+					bra = (ket ^ bitmask(i));
 				} else {
 					return false; // cannot construct, there's already one
 				}
@@ -287,21 +257,6 @@ namespace LanczosPlusPlus {
 			return true;
 		}
 
-		int doSignGf(WordType b,size_t ind) const
-		{
-			if (ind==0) return 1;
-
-			// ind>0 from now on
-			size_t i = 0;
-			size_t j = ind;
-			WordType mask = b;
-			mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-			int s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-			// Is there a down at i?
-			if (bitmask_[i] & b) s = -s;
-			return s;
-		}
-
 		size_t maxElectrons() const
 		{
 			size_t sum = 0;
@@ -312,44 +267,17 @@ namespace LanczosPlusPlus {
 
 		size_t orbs() const { return orbsPerSite_[0]; }
 
-		void fillPartialBasis(std::vector<WordType>& partialBasis,size_t npart)
+		void fillPartialBasis(std::vector<WordType>& partialBasis,size_t npart) const
 		{
-			/* compute size of basis */
-			size_t hilbert=1;
-			int n=nsite_;
-			size_t m=1;
-			for (;m<=npart;n--,m++)
-				hilbert=hilbert*n/m;
-
-			if (partialBasis.size()!=hilbert) {
-				partialBasis.clear();
-				partialBasis.resize(hilbert);
-			}
-
-			if (npart==0) {
-				partialBasis[0]=0;
-				return;
-			}
-			/* define basis states */
-			WordType ket = (1ul<<npart)-1;
-			for (size_t i=0;i<hilbert;i++) {
-				partialBasis[i] = ket;
-				n=m=0;
-				for (;(ket&3)!=1;n++,ket>>=1) {
-					m += ket&1;
-				}
-				ket = ((ket+1)<<n) ^ ((1<<m)-1);
-			}
+			Combinations<WordType>::fill(partialBasis,nsite_,npart,comb_,threads_);
 		}
 
 		void collateBasis(size_t& counter,
-		                  size_t& counter2,
 		                  const std::vector<WordType>& basisA,
 		                  const std::vector<WordType>& basisB)
 		{
 			for (size_t i=0;i<basisA.size();i++) {
 				for (size_t j=0;j<basisB.size();j++) {
-					reordering_[counter2++]=counter;
 					if (isForbiddenSite(basisB[j])) continue;
 					WordType ket = getCollatedKet(basisA[i],basisB[j]);
 					assert(counter<data_.size());
@@ -362,38 +290,28 @@ namespace LanczosPlusPlus {
 		{
 			for (size_t i=0;i<orbsPerSite_.size();i++) {
 				if (orbsPerSite_[i]>1) continue;
-				WordType mask = (1<<i);
+				WordType mask = BitWordType::bit(i);
 				if (mask & ket) return true;
 			}
 			return false;
 		}
 
-		void doCombinatorial()
+		void doRankTables()
 		{
-			/* look-up table for binomial coefficients */
-			comb_.reset(orbs()*nsite_+1,orbs()*nsite_+1);
-
-			for (size_t n=0;n<comb_.n_row();n++)
-				for (size_t i=0;i<comb_.n_col();i++)
-					comb_(n,i)=0;
-
-			for (size_t n=0;n<comb_.n_row();n++) {
-				size_t m = 0;
-				int j = n;
-				size_t i = 1;
-				size_t cnm  = 1;
-				for (;m<=n/2;m++,cnm=cnm*j/i,i++,j--)
-					comb_(n,m) = comb_(n,n-m) = cnm;
+			sitesBelow_.resize(nsite_+1);
+			sitesBelow_[0] = 0;
+			for (size_t i=0;i<nsite_;i++)
+				sitesBelow_[i+1] = sitesBelow_[i] + ((orbsPerSite_[i]>1) ? 1 : 0);
+
+			offset_.resize(npart_+1);
+			offset_[0] = 0;
+			for (size_t na=0;na<npart_;na++) {
+				size_t states = comb_(nsite_,na)*comb_(sitesWithTwoOrbitals(),npart_-na);
+				offset_[na+1] = offset_[na] + states;
 			}
 		}
 
-		void doBitmask()
-		{
-			bitmask_.resize(nsite_*4+1);
-			bitmask_[0]=1ul;
-			for (size_t i=1;i<bitmask_.size();i++)
-				bitmask_[i] = bitmask_[i-1]<<1;
-		}
+		size_t sitesWithTwoOrbitals() const { return sitesBelow_[nsite_]; }
 
 		size_t perfectIndexPartial(WordType state) const
 		{
@@ -404,78 +322,60 @@ namespace LanczosPlusPlus {
 			return n;
 		}
 
-		WordType getCollatedKet(WordType ketA,WordType ketB) const
+		// as perfectIndexPartial, counting only sites with 2 orbitals
+		size_t perfectIndexPartialB(WordType state) const
 		{
-			WordType remA = ketA;
-			WordType remB = ketB;
-			size_t counter = 0;
-			WordType ket = 0;
-
-			while(remA || remB) {
-				size_t bitA = (remA & 1);
-				size_t bitB = (remB & 1);
-				if (bitA) ket |=bitmask_[counter];
-				if (bitB)  ket |=bitmask_[counter+1];
-				counter += 2;
-				if (remA) remA >>= 1;
-				if (remB) remB >>= 1;
-			}
-			return ket;
+			size_t n=0;
+			for (size_t b=0,c=1;state>0;b++,state>>=1)
+				if (state&1) n += comb_(sitesBelow_[b],c++);
+
+			return n;
 		}
 
-		void uncollateKet(WordType& ketA,WordType& ketB,WordType ket) const
+		// ketA on the even bits, ketB on the odd bits
+		WordType getCollatedKet(WordType ketA,WordType ketB) const
 		{
-			size_t counter = 0;
-			ketA = ketB = 0;
-			while(ket) {
-				size_t bitA = (ket & 1);
-				size_t bitB = (ket & 2);
-				if (bitA) ketA |= bitmask_[counter];
-				if (bitB) ketB |= bitmask_[counter];
-				counter++;
-				ket >>= 2;
-			}
+			return FermionSignType::deposit(ketA,maskA_,bmi2_) |
+			       FermionSignType::deposit(ketB,maskB_,bmi2_);
 		}
 
-		int doSign(WordType a, size_t i) const
+		void uncollateKet(WordType& ketA,WordType& ketB,WordType ket) const
 		{
-			if (i==nsite_-1) return 1;
-
-			a &= ((1 << (i+1)) - 1) ^ ((1 << nsite_) - 1);
-			// Parity of single occupied between i and nsite-1
-			int s=(PsimagLite::BitManip::count(a) & 1) ? FERMION_SIGN : 1;
-			return s;
+			ketA = FermionSignType::extract(ket,maskA_,bmi2_);
+			ketB = FermionSignType::extract(ket,maskB_,bmi2_);
 		}
 
-		size_t getNbyKet(size_t ket,size_t from,size_t upto) const
+		// Parity of the electrons after site i
+		int doSign(WordType a, size_t i) const
 		{
-			size_t sum = 0;
-			size_t counter = from;
-			while(counter<upto) {
-				if (ket & bitmask_[counter]) sum++;
-				counter++;
-			}
-			return sum;
+			return FermionSignType::signBetween(a,i+1,nsite_);
 		}
 
 		const std::vector<size_t>& orbsPerSite_;
+		size_t nsite_;
 		size_t npart_;
+		size_t threads_;
+		Binomial comb_;
 		std::vector<WordType> data_;
-		std::vector<WordType> reordering_;
+		std::vector<size_t> sitesBelow_;
+		std::vector<size_t> offset_;
+		bool bmi2_;
+		WordType maskA_;
+		WordType maskB_;
 
 	}; // class BasisOneSpinImmm
 
-	std::ostream& operator<<(std::ostream& os,const BasisOneSpinImmm& b)
+	template<typename WordType_>
+	std::ostream& operator<<(std::ostream& os,const BasisOneSpinImmm<WordType_>& b)
 	{
-		for (size_t i=0;i<b.size();i++)
-			os<<i<<" "<<b[i]<<"\n";
+		for (size_t i=0;i<b.size();i++) {
+			os<<i<<" ";
+			BitWord<WordType_>::print(os,b[i]);
+			os<<"\n";
+		}
 		return os;
 	}
 
-	size_t BasisOneSpinImmm::nsite_=0;
-	PsimagLite::Matrix<size_t> BasisOneSpinImmm::comb_;
-	std::vector<BasisOneSpinImmm::WordType> BasisOneSpinImmm::bitmask_;
-
 } // namespace LanczosPlusPlus
 #endif
 
@@ -23,36 +23,53 @@ Please see full open source license included in file LICENSE.
 
 #include "CrsMatrix.h"
 #include "BasisImmm.h"
-#include "SparseRowCached.h"
 #include "ParametersImmm.h"
+#include "HamiltonianBuilder.h"
+#include "SymmetryBlockBuilder.h"
 
 namespace LanczosPlusPlus {
 
-template<typename RealType_,typename GeometryType_>
+template<typename RealType_,typename GeometryType_,typename WordType_=unsigned long long>
 	class Immm {
 
 		typedef PsimagLite::Matrix<RealType_> MatrixType;
+		typedef BitWord<WordType_> BitWordType;
 
 	public:
 
 		typedef GeometryType_ GeometryType;
 		typedef ParametersImmm<RealType_> ParametersModelType;
-		typedef BasisImmm<GeometryType> BasisType;
+		typedef BasisImmm<GeometryType,WordType_> BasisType;
 		typedef typename BasisType::WordType WordType;
 		typedef RealType_ RealType;
 		typedef PsimagLite::CrsMatrix<RealType> SparseMatrixType;
-		typedef PsimagLite::SparseRowCached<SparseMatrixType> SparseRowType;
+		typedef SparseRowBuffer<RealType> SparseRowType;
 		typedef std::vector<RealType> VectorType;
+
+		// What the on-the-fly product needs for one basis
+		struct OnTheFlyDataType {
+			OnTheFlyDataType() : basis(0) {}
+
+			const BasisType* basis;
+			std::vector<RealType> diag;
+		};
 //		typedef ReflectionSymmetry<GeometryType,BasisType> ReflectionSymmetryType;
 
 		enum {SPIN_UP=BasisType::SPIN_UP,SPIN_DOWN=BasisType::SPIN_DOWN};
 
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
 
+		// setupOnTheFly and matrixVectorProduct, see InternalProductOnTheFly.h
+		enum {HAS_ON_THE_FLY=1};
+
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 
-		Immm(size_t nup,size_t ndown,const ParametersModelType& mp,const GeometryType& geometry)
-		: mp_(mp),geometry_(geometry),basis_(geometry,nup,ndown)
+		Immm(size_t nup,
+		     size_t ndown,
+		     const ParametersModelType& mp,
+		     const GeometryType& geometry,
+		     size_t threads = 1)
+		: mp_(mp),geometry_(geometry),basis_(geometry,nup,ndown,threads)
 		{}
 
 		size_t size() const { return basis_.size(); }
@@ -74,6 +91,12 @@ template<typename RealType_,typename GeometryType_>
 //			rs.transform(matrix,matrix2);
 		}
 
+		//! A basis of this model with nup and ndown electrons, see SectorCache.h
+		BasisType* newBasis(size_t nup,size_t ndown,size_t threads) const
+		{
+			return new BasisType(geometry_,nup,ndown,threads);
+		}
+
 		bool hasNewParts(std::pair<size_t,size_t>& newParts,
 						 size_t what2,
 						 size_t type,
@@ -109,45 +132,24 @@ template<typename RealType_,typename GeometryType_>
 			std::cerr<<" modif="<<(modifVector*modifVector)<<"\n";
 		}
 
-		void matrixVectorProduct(VectorType &x,const VectorType& y) const
+		//! Builds what matrixVectorProduct needs for basis, once per basis
+		void setupOnTheFly(OnTheFlyDataType& data,const BasisType& basis) const
 		{
-			matrixVectorProduct(x,y,&basis_);
+			data.basis = &basis;
+			data.diag.resize(basis.size());
+			calcDiagonalElements(data.diag,basis);
 		}
 
 		void matrixVectorProduct(VectorType &x,
 		                         const VectorType& y,
-		                         const BasisType* basis) const
+		                         const OnTheFlyDataType& data) const
 		{
-			// Calculate diagonal elements AND count non-zero matrix elements
-			size_t hilbert=basis->size();
-			std::vector<RealType> diag(hilbert);
-			calcDiagonalElements(diag,*basis);
-
-			size_t nsite = geometry_.numberOfSites();
-
-			// Calculate off-diagonal elements AND store matrix
-			size_t cacheSize = hilbert/10;
-			if (cacheSize<100) cacheSize=100;
-			SparseRowType sparseRow(cacheSize);
+			size_t hilbert=data.basis->size();
+			SparseRowType sparseRow;
+			sparseRow.reserveColumns(hilbert);
 			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				WordType ket1 = basis->operator()(ispace,SPIN_UP);
-				WordType ket2 = basis->operator()(ispace,SPIN_DOWN);
-				// Save diagonal
-				sparseRow.add(ispace,diag[ispace]);
-				for (size_t i=0;i<nsite;i++) {
-					for (size_t orb=0;orb<basis->orbsPerSite(i);orb++) {
-						setHoppingTerm(sparseRow,ket1,ket2,ispace,i,orb,*basis);
-// 						if (orb==0) {
-// 							setU2OffDiagonalTerm(sparseRow,ket1,ket2,
-// 								i,orb,basis);
-// 						}
-// 						setU3Term(sparseRow,ket1,ket2,
-// 								i,orb,1-orb,basis);
-// 						setJTermOffDiagonal(sparseRow,ket1,ket2,
-// 								i,orb,basis);
-					}
-				}
-				//nCounter += sparseRow.finalize(matrix);
+				sparseRow.clear();
+				fillRow(sparseRow,ispace,*data.basis,data.diag);
 				x[ispace] += sparseRow.matrixVectorProduct(y);
 			}
 		}
@@ -157,43 +159,55 @@ template<typename RealType_,typename GeometryType_>
 		const BasisType& basis() const { return basis_; }
 
 		void setupHamiltonian(SparseMatrixType &matrix,
-		                      const BasisType &basis) const
+		                      const BasisType &basis,
+		                      size_t threads = 1,
+		                      bool upperOnly = false) const
 		{
-			// Calculate diagonal elements AND count non-zero matrix elements
-			size_t hilbert=basis.size();
-			std::vector<RealType> diag(hilbert);
+			std::vector<RealType> diag(basis.size());
 			calcDiagonalElements(diag,basis);
 
-			size_t nsite = geometry_.numberOfSites();
+			HamiltonianBuilder<Immm> builder(*this,basis,diag,threads,upperOnly);
+			builder.build(matrix);
+		}
 
-			// Setup CRS matrix
-			matrix.resize(hilbert,hilbert);
+		//! The Hamiltonian in each sector of symmetry, see SymmetryBlockBuilder.h
+		template<typename SymmetryType>
+		void setupHamiltonian(std::vector<typename SymmetryType::MatrixStoredType>& blocks,
+		                      const BasisType &basis,
+		                      const SymmetryType& symmetry,
+		                      size_t threads) const
+		{
+			std::vector<RealType> diag(basis.size());
+			calcDiagonalElements(diag,basis);
 
-			// Calculate off-diagonal elements AND store matrix
-			size_t nCounter=0;
-			SparseRowType sparseRow(100);
-			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				matrix.setRow(ispace,nCounter);
-				WordType ket1 = basis(ispace,SPIN_UP);
-				WordType ket2 = basis(ispace,SPIN_DOWN);
-				// Save diagonal
-				sparseRow.add(ispace,diag[ispace]);
-				for (size_t i=0;i<nsite;i++) {
-					for (size_t orb=0;orb<basis.orbsPerSite(i);orb++) {
-						setHoppingTerm(sparseRow,ket1,ket2,ispace,i,orb,basis);
-// 						if (orb==0) {
-// 							setU2OffDiagonalTerm(sparseRow,ket1,ket2,
-// 								i,orb,basis);
-// 						}
-// 						setU3Term(sparseRow,ket1,ket2,
-// 								i,orb,1-orb,basis);
-// 						setJTermOffDiagonal(sparseRow,ket1,ket2,
-// 								i,orb,basis);
-					}
+			SymmetryBlockBuilder<Immm,SymmetryType> builder(*this,basis,diag,symmetry,threads);
+			builder.build(blocks);
+		}
+
+		//! Adds the entries of row ispace, called by HamiltonianBuilder and SymmetryBlockBuilder
+		void fillRow(SparseRowType& sparseRow,
+		             size_t ispace,
+		             const BasisType& basis,
+		             const std::vector<RealType>& diag) const
+		{
+			size_t nsite = geometry_.numberOfSites();
+			WordType ket1 = basis(ispace,SPIN_UP);
+			WordType ket2 = basis(ispace,SPIN_DOWN);
+			// Save diagonal
+			sparseRow.add(ispace,diag[ispace]);
+			for (size_t i=0;i<nsite;i++) {
+				for (size_t orb=0;orb<basis.orbsPerSite(i);orb++) {
+					setHoppingTerm(sparseRow,ket1,ket2,ispace,i,orb,basis);
+// 					if (orb==0) {
+// 						setU2OffDiagonalTerm(sparseRow,ket1,ket2,
+// 							i,orb,basis);
+// 					}
+// 					setU3Term(sparseRow,ket1,ket2,
+// 							i,orb,1-orb,basis);
+// 					setJTermOffDiagonal(sparseRow,ket1,ket2,
+// 							i,orb,basis);
 				}
-				nCounter += sparseRow.finalize(matrix);
 			}
-			matrix.setRow(hilbert,nCounter);
 		}
 
 		//! Gf Related function:
@@ -219,7 +233,7 @@ template<typename RealType_,typename GeometryType_>
 					s += "\n";
 					s += "what=" + ttos(what) + " spin=" + ttos(spin);
 					s += " site=" + ttos(site);
-					s += "ket1=" + ttos(ket1) + " and ket2=" + ttos(ket2);
+					s += "ket1=" + BitWordType::toString(ket1) + " and ket2=" + BitWordType::toString(ket2);
 					s += "\n";
 					s += "getModifiedState: z.size=" + ttos(z.size());
 					s += " but temp=" + ttos(temp) + "\n";
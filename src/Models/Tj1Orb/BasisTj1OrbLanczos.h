@@ -5,19 +5,61 @@
 #ifndef BASIS_TJ_1ORB_LANCZOS_H
 #define BASIS_TJ_1ORB_LANCZOS_H
 
-#include "BitManip.h"
+#include "BitWord.h"
+#include "Binomial.h"
+#include "Combinations.h"
+#include "FermionSign.h"
+#include "Parallelizer.h"
 #include "ProgramGlobals.h"
 
 namespace LanczosPlusPlus {
 	
-	template<typename GeometryType>
+	template<typename GeometryType,typename WordType_>
 	class BasisTj1OrbLanczos {
 
-	public:		
+		typedef BitWord<WordType_> BitWordType;
+		typedef FermionSign<WordType_> FermionSignType;
+
+		enum {MAX_CHUNK_SITES=8};
+
+		// threadNum puts the states of its block of up kets, see fillChunkOrdered
+		class FillHelper {
+
+		public:
+
+			FillHelper(const BasisTj1OrbLanczos& basis,
+			           const std::vector<WordType_>& data1,
+			           const std::vector<WordType_>& data2,
+			           std::vector<WordType_>& data)
+			: basis_(basis),data1_(data1),data2_(data2),data_(data)
+			{}
+
+			void thread_function_(size_t threadNum,size_t threads)
+			{
+				size_t n = basis_.geometry_.numberOfSites();
+				size_t start = (data1_.size()*threadNum)/threads;
+				size_t end = (data1_.size()*(threadNum+1))/threads;
+				for (size_t i=start;i<end;i++) {
+					for (size_t j=0;j<data2_.size();j++) {
+						if (basis_.isDoublyOccupied(data1_[i],data2_[j])) continue;
+						size_t index = basis_.perfectIndexUnchecked(data1_[i],data2_[j]);
+						assert(index<data_.size());
+						data_[index] = (data2_[j]<<n) | data1_[i];
+					}
+				}
+			}
 
-		typedef unsigned int long long WordType;
+		private:
+
+			const BasisTj1OrbLanczos& basis_;
+			const std::vector<WordType_>& data1_;
+			const std::vector<WordType_>& data2_;
+			std::vector<WordType_>& data_;
+		}; // class FillHelper
+
+	public:		
 
-		static std::vector<WordType> bitmask_;
+		typedef WordType_ WordType;
 
 		enum {SPIN_UP,SPIN_DOWN};
 
@@ -25,24 +67,23 @@ namespace LanczosPlusPlus {
 
 		static int const FERMION_SIGN = -1;
 
-		BasisTj1OrbLanczos(const GeometryType& geometry, size_t nup,size_t ndown)
+		BasisTj1OrbLanczos(const GeometryType& geometry,
+		                   size_t nup,
+		                   size_t ndown,
+		                   size_t threads = 1)
 		: geometry_(geometry),nup_(nup),ndown_(ndown)
 		{
-			assert(bitmask_.size()==0 || bitmask_.size()==geometry_.numberOfSites());
-			if (bitmask_.size()==0) doBitmask();
-			std::vector<WordType> data1;
-			fillOneSector(data1,nup);
-			std::vector<WordType> data2;
-			fillOneSector(data2,ndown);
-			combineAndFilter(data1,data2);
-			std::sort(data_.begin(),data_.end());
+			if (2*geometry_.numberOfSites()>size_t(BitWordType::BITS))
+				throw std::runtime_error("BasisTj1OrbLanczos: too many sites for WordType\n");
+			doChunkTables();
+			fillChunkOrdered(threads);
 //			for (size_t i=0;i<data_.size();i++)
 //				std::cout<<"data["<<i<<"]="<<data_[i]<<"\n";
 		}
 		
-		static const WordType& bitmask(size_t i)
+		static WordType bitmask(size_t i)
 		{
-			return bitmask_[i];
+			return BitWordType::bit(i);
 		}
 
 		size_t size() const { return data_.size(); }
@@ -56,39 +97,24 @@ namespace LanczosPlusPlus {
 			return perfectIndex(kets[0],kets[1]);
 		}
 
+		/* Lin's tables: the sites are split into chunks, and the basis is
+		 * ordered by the first chunk, then by the second, and so on. The
+		 * index is then a sum of one table read per chunk, given the
+		 * electrons still to place (see doChunkTables). Up to
+		 * 2*MAX_CHUNK_SITES sites there are two chunks, the left and right
+		 * halves, and the last table is just the rank of the right half
+		 */
 		size_t perfectIndex(WordType ket1,WordType ket2) const
 		{
-			assert(size_t(PsimagLite::BitManip::count(ket1))==nup_);
-			assert(size_t(PsimagLite::BitManip::count(ket2))==ndown_);
-			size_t n = geometry_.numberOfSites();
-			WordType w = ket2;
-			w <<= n;
-			w |= ket1;
-			size_t elements = data_.size();
-			size_t i = elements/2;
-			size_t start = 0;
-			size_t end = elements;
-			size_t counter = 0;
-			size_t max = size_t(0.1*elements);
-			if (max>100) max = 100;
-		       	if (max<1) max = 1;
-
-			while(counter<max) {
-				if (data_[i]==w) return i;
-				if (data_[i]>w) {
-					if (i<end) end = i;
-					i = i/2;
-				} else {
-					if (i>start) start = i; 
-			 		i = (i+elements)/2;
-				}
-				counter++;
-			}
-			for (size_t j=start;j<end;++j) {
-				if (data_[j] == w) return j;
-			}
-			assert(false);
-			return 0;
+			size_t i = perfectIndexUnchecked(ket1,ket2);
+			assert(i<data_.size() && data_[i]==((ket2<<geometry_.numberOfSites()) | ket1));
+			return i;
+		}
+
+		//! Bytes taken by the tables of perfectIndex
+		size_t indexMemory() const
+		{
+			return chunkTable_.size()*sizeof(size_t);
 		}
 
 		size_t electrons(size_t what) const
@@ -100,8 +126,7 @@ namespace LanczosPlusPlus {
 		{
 			size_t n = geometry_.numberOfSites();
 			WordType w = data_[i];
-			WordType mask = (1<<n);
-			mask--;
+			WordType mask = BitWordType::lowMask(n);
 			if (spin==SPIN_UP) {
 				return (w & mask);
 			}
@@ -125,33 +150,11 @@ namespace LanczosPlusPlus {
 			return (spin==SPIN_UP) ? getN(ket1,site) : getN(ket2,site);
 		}
 		
+		// Parity of the electrons before site ind; downs come after all ups
 		int doSignGf(WordType a, WordType b,size_t ind,size_t sector) const
 		{
-			if (sector==SPIN_UP) {
-				if (ind==0) return 1;
-
-				// ind>0 from now on
-				size_t i = 0;
-				size_t j = ind;
-				WordType mask = a;
-				mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-				int s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-				// Is there an up at i?
-				if (bitmask_[i] & a) s = -s;
-				return s;
-			}
-			int s=(PsimagLite::BitManip::count(a) & 1) ? -1 : 1; // Parity of up
-			if (ind==0) return s;
-
-			// ind>0 from now on
-			size_t i = 0;
-			size_t j = ind;
-			WordType mask = b;
-			mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-			s *= (PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-			// Is there a down at i?
-			if (bitmask_[i] & b) s = -s;
-			return s;
+			if (sector==SPIN_UP) return FermionSignType::signBetween(a,0,ind);
+			return FermionSignType::sign(a) * FermionSignType::signBetween(b,0,ind);
 		}
 
 		int doSign(WordType ket1,
@@ -196,8 +199,8 @@ namespace LanczosPlusPlus {
 			return 0;
 		}
 
-		template<typename GeometryType2>
-		friend std::ostream& operator<<(std::ostream& os,const BasisTj1OrbLanczos<GeometryType2>& basis);
+		template<typename GeometryType2,typename WordType2>
+		friend std::ostream& operator<<(std::ostream& os,const BasisTj1OrbLanczos<GeometryType2,WordType2>& basis);
 
 	private:
 
@@ -207,102 +210,143 @@ namespace LanczosPlusPlus {
 			return (tmp>0);
 		}
 
-		void fillOneSector(std::vector<WordType>& data1,size_t npart) const
+		// data_ is filled with this, see fillChunkOrdered
+		size_t perfectIndexUnchecked(WordType ket1,WordType ket2) const
 		{
-			/* compute size of basis */
-			size_t hilbert=1;
-			int n=geometry_.numberOfSites();
-			size_t m=1;
-			for (;m<=npart;n--,m++)
-				hilbert=hilbert*n/m;
-
-			if (data1.size()!=hilbert) {
-				data1.clear();
-				data1.resize(hilbert);
+			assert(size_t(BitWordType::count(ket1))==nup_);
+			assert(size_t(BitWordType::count(ket2))==ndown_);
+			size_t i = 0;
+			size_t nu = nup_;
+			size_t nd = ndown_;
+			size_t chunks = chunkStart_.size()-1;
+			for (size_t c=0;c<chunks;c++) {
+				size_t start = chunkStart_[c];
+				size_t sites = chunkStart_[c+1] - start;
+				WordType mask = BitWordType::lowMask(sites);
+				WordType up = (ket1>>start) & mask;
+				WordType down = (ket2>>start) & mask;
+				size_t code = BitWordType::low(up | (down<<sites));
+				i += chunkTable_[chunkOffset_[c] + slice(c,nu,nd)*(size_t(1)<<(2*sites)) + code];
+				nu -= BitWordType::count(up);
+				nd -= BitWordType::count(down);
 			}
+			return i;
+		}
 
-			if (npart==0) {
-				data1[0]=0;
-				return;
+		/* A chunk of w sites is coded as up | (down<<w). For each chunk
+		 * but the last, and each number of electrons (nu,nd) still to
+		 * place, the table has for each code the number of states whose
+		 * chunk has a smaller code, that is, the sum over smaller codes
+		 * with nu' up and nd' down of the ways to place (nu-nu',nd-nd')
+		 * in the chunks after it. The last chunk must take exactly what
+		 * remains, so its table is the rank of its code among codes with
+		 * the same electrons. The first chunk only needs (nup_,ndown_)
+		 */
+		void doChunkTables()
+		{
+			size_t n = geometry_.numberOfSites();
+			size_t chunks = 2;
+			if (n>2*MAX_CHUNK_SITES) chunks = (n + MAX_CHUNK_SITES - 1)/MAX_CHUNK_SITES;
+			chunkStart_.resize(chunks+1);
+			for (size_t c=0;c<=chunks;c++) chunkStart_[c] = (n*c)/chunks;
+
+			Binomial binomial(n);
+
+			chunkOffset_.resize(chunks);
+			size_t total = 0;
+			for (size_t c=0;c<chunks;c++) {
+				chunkOffset_[c] = total;
+				size_t sites = chunkStart_[c+1] - chunkStart_[c];
+				total += slices(c)*(size_t(1)<<(2*sites));
 			}
-
-			/* define basis states */
-			WordType ket = (1ul<<npart)-1;
-			for (size_t i=0;i<hilbert;i++) {
-				data1[i] = ket;
-				n=m=0;
-				for (;(ket&3)!=1;n++,ket>>=1) {
-					m += ket&1;
+			chunkTable_.assign(total,0);
+
+			for (size_t c=0;c<chunks;c++) {
+				size_t sites = chunkStart_[c+1] - chunkStart_[c];
+				size_t codes = (size_t(1)<<(2*sites));
+				size_t after = n - chunkStart_[c+1];
+				for (size_t nu=0;nu<=nup_;nu++) {
+					for (size_t nd=0;nd<=ndown_;nd++) {
+						if (c==0 && (nu!=nup_ || nd!=ndown_)) continue;
+						if (c+1==chunks && (nu>0 || nd>0)) continue;
+						size_t* table = &chunkTable_[chunkOffset_[c] + slice(c,nu,nd)*codes];
+						std::vector<size_t> rank((sites+1)*(sites+1),0);
+						size_t smaller = 0;
+						for (size_t code=0;code<codes;code++) {
+							size_t nuc = 0;
+							size_t ndc = 0;
+							if (!countChunk(nuc,ndc,code,sites)) continue;
+							if (c+1==chunks) {
+								table[code] = rank[nuc*(sites+1) + ndc]++;
+								continue;
+							}
+							table[code] = smaller;
+							if (nuc>nu || ndc>nd || nu-nuc+nd-ndc>after) continue;
+							smaller += binomial(after,nu-nuc)*binomial(after-nu+nuc,nd-ndc);
+						}
+					}
 				}
-				ket = ((ket+1)<<n) ^ ((1<<m)-1);
 			}
 		}
 
-		void combineAndFilter(const std::vector<WordType>& data1,const std::vector<WordType>& data2)
+		size_t slices(size_t c) const
 		{
-			WordType tmp = 0;
-			WordType tmp2 = 0;
-			size_t n=geometry_.numberOfSites();
-			for (size_t i=0;i<data1.size();i++) {
-				for (size_t j=0;j<data2.size();j++) {
-					tmp = (data1[i] & data2[j]);
-					if (tmp>0) continue; // there's one or more double occupied
-					tmp2 = data2[j];
-					tmp2 <<= n;
-					data_.push_back(tmp2 | data1[i]);
-				}
-			}
+			if (c==0 || c+2==chunkStart_.size()) return 1;
+			return (nup_+1)*(ndown_+1);
 		}
 
-		size_t isThereAnElectronAt(WordType ket,size_t site) const
+		size_t slice(size_t c,size_t nu,size_t nd) const
 		{
-			return (ket & bitmask_[site]) ? 1 : 0;
+			if (c==0 || c+2==chunkStart_.size()) return 0;
+			return nu*(ndown_+1) + nd;
 		}
 
-		size_t getN(WordType ket,size_t site) const
+		// false if the chunk is doubly occupied somewhere
+		static bool countChunk(size_t& nu,size_t& nd,size_t code,size_t sites)
 		{
-			return isThereAnElectronAt(ket,site);
+			size_t up = code & ((size_t(1)<<sites) - 1);
+			size_t down = (code>>sites);
+			if (up & down) return false;
+			nu = BitWordType::count(up);
+			nd = BitWordType::count(down);
+			return true;
 		}
 
-		void doBitmask()
+		/* Each state goes where perfectIndex says, so the up kets can be
+		 * split among threads with no sort, and the number of states is
+		 * C(n,nup)*C(n-nup,ndown)
+		 */
+		void fillChunkOrdered(size_t threads)
 		{
 			size_t n = geometry_.numberOfSites();
-			bitmask_.resize(n);
-			bitmask_[0]=1ul;
-			for (size_t i=1;i<n;i++)
-				bitmask_[i] = bitmask_[i-1]<<1;
+			Binomial comb(n);
+			std::vector<WordType> data1;
+			Combinations<WordType>::fill(data1,n,nup_,comb,threads);
+			std::vector<WordType> data2;
+			Combinations<WordType>::fill(data2,n,ndown_,comb,threads);
+
+			size_t hilbert = 0;
+			if (nup_+ndown_<=n) hilbert = comb(n,nup_)*comb(n-nup_,ndown_);
+			data_.resize(hilbert);
+			FillHelper helper(*this,data1,data2,data_);
+			Parallelizer<FillHelper> parallelizer(threads);
+			parallelizer.loopCreate(helper);
 		}
 
-		int doSign(WordType ket,size_t i,size_t j) const
+		size_t isThereAnElectronAt(WordType ket,size_t site) const
 		{
-			assert(i <= j);
-			size_t x0 = (i+1); // i+1 cannot be the last site, 'cause i<j
-			size_t x1 = j;
-
-			size_t sum = getNbyKet(ket,x0,x1);
-
-			// at site i we need to be carefull
-			x0 = i;
-			x1 = (i+1);
-			sum += getNbyKet(ket,x0,x1);
-
-			// same at site j
-			x0 = j;
-			x1 = j;
-			sum += getNbyKet(ket,x0,x1);
+			return (ket & bitmask(site)) ? 1 : 0;
+		}
 
-			return (sum & 1) ? FERMION_SIGN : 1;
+		size_t getN(WordType ket,size_t site) const
+		{
+			return isThereAnElectronAt(ket,site);
 		}
 
-		size_t getNbyKet(size_t ket,size_t from,size_t upto) const
+		int doSign(WordType ket,size_t i,size_t j) const
 		{
-			size_t sum = 0;
-			size_t counter = from;
-			while(counter<upto) {
-				if (ket & bitmask_[counter]) sum++;
-				counter++;
-			}
-			return sum;
+			assert(i <= j);
+			return FermionSignType::hopSign(ket,i,0,j,0,1);
 		}
 
 		int getBraC(WordType& bra,
@@ -325,16 +369,16 @@ namespace LanczosPlusPlus {
 
 		int getBraC(WordType& bra,const WordType& ket,size_t what,size_t site) const
 		{
-			WordType si=(ket & bitmask_[site]);
+			WordType si=(ket & bitmask(site));
 			if (what==DESTRUCTOR) {
 				if (si>0) {
-					bra = (ket ^ bitmask_[site]);
+					bra = (ket ^ bitmask(site));
 				} else {
 					return 0; // cannot destroy, there's nothing
 				}
 			} else {
 				if (si==0) {
-					bra = (ket ^ bitmask_[site]);
+					bra = (ket ^ bitmask(site));
 				} else {
 					return 0; // cannot construct, there's already one
 				}
@@ -351,10 +395,8 @@ namespace LanczosPlusPlus {
 			assert(spin==SPIN_UP); // spin index is bogus here
 			if (spin==SPIN_UP) bra = ket1;
 			else bra = ket2;
-			WordType siup=(ket1 & bitmask_[site]);
-			WordType sidown=(ket2 & bitmask_[site]);
-			if (siup>0) siup=1;
-			if (sidown>0) sidown=1;
+			int siup = (ket1 & bitmask(site)) ? 1 : 0;
+			int sidown = (ket2 & bitmask(site)) ? 1 : 0;
 			return (siup-sidown);
 		}
 
@@ -362,19 +404,22 @@ namespace LanczosPlusPlus {
 		size_t nup_;
 		size_t ndown_;
 		std::vector<WordType> data_;
+		std::vector<size_t> chunkStart_;
+		std::vector<size_t> chunkOffset_;
+		std::vector<size_t> chunkTable_;
 	}; // class BasisTj1OrbLanczos
 	
-	template<typename GeometryType>
-	std::ostream& operator<<(std::ostream& os,const BasisTj1OrbLanczos<GeometryType>& basis)
+	template<typename GeometryType,typename WordType>
+	std::ostream& operator<<(std::ostream& os,const BasisTj1OrbLanczos<GeometryType,WordType>& basis)
 	{
-		for (size_t i=0;i<basis.data_.size();i++)
-			os<<i<<" "<<basis.data_[i]<<"\n";
+		for (size_t i=0;i<basis.data_.size();i++) {
+			os<<i<<" ";
+			BitWord<WordType>::print(os,basis.data_[i]);
+			os<<"\n";
+		}
 		return os;
 	}
 
-	template<typename GeometryType>
-	std::vector<typename BasisTj1OrbLanczos<GeometryType>::WordType> BasisTj1OrbLanczos<GeometryType>::bitmask_;
-
 
 } // namespace LanczosPlusPlus
 #endif
@@ -7,25 +7,29 @@
 
 #include "CrsMatrix.h"
 #include "BasisTj1OrbLanczos.h"
-#include "BitManip.h"
+#include "BitWord.h"
+#include "FermionSign.h"
 #include "TypeToString.h"
-#include "SparseRow.h"
 #include "ParametersTj1Orb.h"
+#include "HamiltonianBuilder.h"
+#include "SymmetryBlockBuilder.h"
 
 namespace LanczosPlusPlus {
 
-	template<typename RealType_,typename GeometryType_>
+	template<typename RealType_,typename GeometryType_,typename WordType_=unsigned long long>
 	class Tj1Orb {
 
 		typedef PsimagLite::Matrix<RealType_> MatrixType;
+		typedef BitWord<WordType_> BitWordType;
+		typedef FermionSign<WordType_> FermionSignType;
 
 	public:
 
 		typedef ParametersTj1Orb<RealType_> ParametersModelType;
 		typedef GeometryType_ GeometryType;
 		typedef PsimagLite::CrsMatrix<RealType_> SparseMatrixType;
-		typedef PsimagLite::SparseRow<SparseMatrixType> SparseRowType;
-		typedef BasisTj1OrbLanczos<GeometryType> BasisType;
+		typedef SparseRowBuffer<RealType_> SparseRowType;
+		typedef BasisTj1OrbLanczos<GeometryType,WordType_> BasisType;
 		typedef typename BasisType::WordType WordType;
 		typedef RealType_ RealType;
 		typedef std::vector<RealType> VectorType;
@@ -34,15 +38,19 @@ namespace LanczosPlusPlus {
 
 		enum {DESTRUCTOR=BasisType::DESTRUCTOR,CONSTRUCTOR=BasisType::CONSTRUCTOR};
 
+		// no on-the-fly product, the Hamiltonian is always stored
+		enum {HAS_ON_THE_FLY=0};
+
 		static int const FERMION_SIGN = BasisType::FERMION_SIGN;
 
 		Tj1Orb(size_t nup,
 		                  size_t ndown,
 						  const ParametersModelType& mp,
-						  const GeometryType& geometry)
+						  const GeometryType& geometry,
+						  size_t threads = 1)
 		: mp_(mp),
 		  geometry_(geometry),
-		  basis_(geometry,nup,ndown),
+		  basis_(geometry,nup,ndown,threads),
 		  hoppings_(geometry_.numberOfSites(),geometry_.numberOfSites()),
 		  j_(geometry_.numberOfSites(),geometry_.numberOfSites()),
 		  w_(geometry_.numberOfSites(),geometry_.numberOfSites())
@@ -71,39 +79,60 @@ namespace LanczosPlusPlus {
 
 		//! Gf. related functions below:
 		void setupHamiltonian(SparseMatrixType &matrix,
-		                      const BasisType &basis) const
+		                      const BasisType &basis,
+		                      size_t threads = 1,
+		                      bool upperOnly = false) const
 		{
-			size_t hilbert=basis.size();
-			std::vector<RealType> diag(hilbert,0.0);
+			std::vector<RealType> diag(basis.size(),0.0);
 			calcDiagonalElements(diag,basis);
-			
-			size_t nsite = geometry_.numberOfSites();
 
-			matrix.resize(hilbert,hilbert);
-			// Calculate off-diagonal elements AND store matrix
-			size_t nCounter=0;
-			for (size_t ispace=0;ispace<hilbert;ispace++) {
-				SparseRowType sparseRow;
-				matrix.setRow(ispace,nCounter);
-				WordType ket1 = basis(ispace,SPIN_UP);
-				WordType ket2 = basis(ispace,SPIN_DOWN);
-//				std::cout<<"ket1="<<ket1<<" ket2="<<ket2<<"\n";
-				// Save diagonal
-				sparseRow.add(ispace,diag[ispace]);
-				for (size_t i=0;i<nsite;i++) {
-					setHoppingTerm(sparseRow,ket1,ket2,i,basis);
-					setSplusSminus(sparseRow,ket1,ket2,i,basis);
-				}
-				nCounter += sparseRow.finalize(matrix);
-			}
-			matrix.setRow(hilbert,nCounter);
+			HamiltonianBuilder<Tj1Orb> builder(*this,basis,diag,threads,upperOnly);
+			builder.build(matrix);
 			matrix.checkValidity();
-			assert(isHermitian(matrix));
+			assert(upperOnly || isHermitian(matrix));
 //			PsimagLite::Matrix<RealType> m;
 //			crsMatrixToFullMatrix(m,matrix);
 //			std::cout<<m;
 		}
 
+		//! The Hamiltonian in each sector of symmetry, see SymmetryBlockBuilder.h
+		template<typename SymmetryType>
+		void setupHamiltonian(std::vector<typename SymmetryType::MatrixStoredType>& blocks,
+		                      const BasisType &basis,
+		                      const SymmetryType& symmetry,
+		                      size_t threads) const
+		{
+			std::vector<RealType> diag(basis.size());
+			calcDiagonalElements(diag,basis);
+
+			SymmetryBlockBuilder<Tj1Orb,SymmetryType> builder(*this,basis,diag,symmetry,threads);
+			builder.build(blocks);
+		}
+
+		//! Adds the entries of row ispace, called by HamiltonianBuilder and SymmetryBlockBuilder
+		void fillRow(SparseRowType& sparseRow,
+		             size_t ispace,
+		             const BasisType& basis,
+		             const std::vector<RealType>& diag) const
+		{
+			size_t nsite = geometry_.numberOfSites();
+			WordType ket1 = basis(ispace,SPIN_UP);
+			WordType ket2 = basis(ispace,SPIN_DOWN);
+//			std::cout<<"ket1="<<ket1<<" ket2="<<ket2<<"\n";
+			// Save diagonal
+			sparseRow.add(ispace,diag[ispace]);
+			for (size_t i=0;i<nsite;i++) {
+				setHoppingTerm(sparseRow,ket1,ket2,i,basis);
+				setSplusSminus(sparseRow,ket1,ket2,i,basis);
+			}
+		}
+
+		//! A basis of this model with nup and ndown electrons, see SectorCache.h
+		BasisType* newBasis(size_t nup,size_t ndown,size_t threads) const
+		{
+			return new BasisType(geometry_,nup,ndown,threads);
+		}
+
 		bool hasNewParts(std::pair<size_t,size_t>& newParts,
 						 size_t what,
 		                 size_t type,
@@ -189,7 +218,7 @@ namespace LanczosPlusPlus {
 					s += "\n";
 					s += "what=" + ttos(what) + " spin=" + ttos(spin);
 					s += " site=" + ttos(site);
-					s += "ket1=" + ttos(ket1) + " and ket2=" + ttos(ket2);
+					s += "ket1=" + BitWordType::toString(ket1) + " and ket2=" + BitWordType::toString(ket2);
 					s += "\n";
 					s += "getModifiedState: z.size=" + ttos(z.size());
 					s += " but temp=" + ttos(temp) + "\n";
@@ -327,34 +356,17 @@ namespace LanczosPlusPlus {
 			}
 		}
 
+		// downs before i and j, ups after i and j
 		int signSplusSminus(size_t i, size_t j,const WordType& bra1, const WordType& bra2) const
 		{
 			size_t n = geometry_.numberOfSites();
-			int s = 1;
-			if (j>0) s *= parityFrom(0,j-1,bra2);
-			if (i>0) s *= parityFrom(0,i-1,bra2);
-			if (i<n-1) s *= parityFrom(i+1,n-1,bra1);
-			if (j<n-1) s *= parityFrom(j+1,n-1,bra1);
+			int s = FermionSignType::signBetween(bra2,0,j);
+			s *= FermionSignType::signBetween(bra2,0,i);
+			s *= FermionSignType::signBetween(bra1,i+1,n);
+			s *= FermionSignType::signBetween(bra1,j+1,n);
 			return -s;
 		}
 
-		// from i to j including i and j
-		// assumes i<=j
-		int parityFrom(size_t i,size_t j,const WordType& ket) const
-		{
-			if (i==j) return (BasisType::bitmask(j) & ket) ? -1 : 1;
-			assert(i<j);
-			//j>i>=0 now
-			WordType mask = ket;
-			mask &= ((1 << (i+1)) - 1) ^ ((1 << j) - 1);
-			int s=(PsimagLite::BitManip::count(mask) & 1) ? -1 : 1; // Parity of up between i and j
-			// Is there something of this species at i?
-			if (BasisType::bitmask(i) & ket) s = -s;
-			// Is there something of this species at j?
-			if (BasisType::bitmask(j) & ket) s = -s;
-			return s;
-		}
-
 		const ParametersModelType& mp_;
 		const GeometryType& geometry_;
 		BasisType basis_;
@@ -0,0 +1,193 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file benchAllocations.cpp
+ *
+ *  Counts the calls to operator new made by setupHamiltonian, with one
+ *  thread and with Threads= of the input, and by one matrixVectorProduct
+ *  of the models that compute it on the fly (see SparseRowBuffer.h)
+ *
+ *  Usage: benchAllocations -f filename, with the input file of lanczos
+ *
+ */
+#include <unistd.h>
+#include <cstdlib>
+#include <getopt.h>
+#include <new>
+#include "ProgramGlobals.h"
+
+#include "Tj1Orb.h"
+#include "Immm.h"
+#include "HubbardOneOrbital.h"
+#include "FeBasedSc.h"
+
+#include "Geometry.h"
+#include "IoSimple.h" // in PsimagLite
+#include "ParametersEngine.h"
+
+using namespace LanczosPlusPlus;
+
+typedef double RealType;
+typedef PsimagLite::Geometry<RealType,ProgramGlobals> GeometryType;
+typedef PsimagLite::IoSimple::In IoInputType;
+#if defined(USE_MULTIWORD)
+typedef MultiWord<USE_MULTIWORD> WordType;
+#elif defined(USE_WORD128)
+typedef unsigned __int128 WordType;
+#else
+typedef unsigned long long WordType;
+#endif
+
+static size_t allocations = 0;
+
+#if __cplusplus < 201103L
+void* operator new(size_t size) throw(std::bad_alloc)
+#else
+void* operator new(size_t size)
+#endif
+{
+	__sync_fetch_and_add(&allocations,1);
+	void* p = malloc((size==0) ? 1 : size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+// not inlined, or g++ sees free() on the result of operator new
+__attribute__((noinline)) void operator delete(void* p) throw()
+{
+	free(p);
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -f filename\n";
+}
+
+template<typename ModelType>
+void countSetup(const ModelType& model,size_t threads)
+{
+	typename ModelType::SparseMatrixType matrix;
+	size_t before = allocations;
+	model.setupHamiltonian(matrix,model.basis(),threads);
+	size_t after = allocations;
+	std::cout<<"setupHamiltonian threads="<<threads<<" nonzeros="<<matrix.nonZero();
+	std::cout<<" allocations="<<(after-before)<<"\n";
+}
+
+//! Only models with HAS_ON_THE_FLY set have a product without the stored Hamiltonian
+template<typename ModelType,bool hasOnTheFly>
+struct OnTheFly {
+	static void count(const ModelType&) {}
+};
+
+template<typename ModelType>
+struct OnTheFly<ModelType,true> {
+	static void count(const ModelType& model)
+	{
+		typename ModelType::VectorType x(model.size(),0);
+		typename ModelType::VectorType y(model.size(),1);
+		typename ModelType::OnTheFlyDataType data;
+		size_t before = allocations;
+		model.setupOnTheFly(data,model.basis());
+		size_t after = allocations;
+		std::cout<<"setupOnTheFly allocations="<<(after-before)<<"\n";
+		for (size_t i=0;i<2;i++) {
+			before = allocations;
+			model.matrixVectorProduct(x,y,data);
+			after = allocations;
+			std::cout<<"matrixVectorProduct call="<<i<<" allocations="<<(after-before)<<"\n";
+		}
+	}
+};
+
+//! Only the t-J basis has tables for perfectIndex
+template<typename ModelType>
+void printIndexMemory(const ModelType&) {}
+
+void printIndexMemory(const Tj1Orb<RealType,GeometryType,WordType>& model)
+{
+	std::cout<<"#indexBytes="<<model.basis().indexMemory()<<"\n";
+}
+
+template<typename ModelType>
+void mainLoop(IoInputType& io,const GeometryType& geometry)
+{
+	typedef typename ModelType::ParametersModelType ParametersModelType;
+
+	ParametersModelType mp(io);
+	size_t nup = 0;
+	size_t ndown = 0;
+	io.readline(nup,"TargetElectronsUp=");
+	io.readline(ndown,"TargetElectronsDown=");
+
+	ParametersEngine<RealType> params(io);
+	size_t threads = params.threads;
+
+	ModelType model(nup,ndown,mp,geometry);
+	std::cout<<"#hilbert="<<model.size()<<"\n";
+	printIndexMemory(model);
+
+	countSetup(model,1);
+	if (threads>1) countSetup(model,threads);
+	OnTheFly<ModelType,ModelType::HAS_ON_THE_FLY>::count(model);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	std::string file = "";
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		default: /* '?' */
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (file == "") {
+		usage(argv[0]);
+		return 1;
+	}
+
+	IoInputType io(file);
+	GeometryType geometry(io);
+
+	std::string model("");
+	io.readline(model,"Model=");
+
+	if (model=="Tj1Orb") {
+		mainLoop<Tj1Orb<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="Immm") {
+		mainLoop<Immm<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="HubbardOneBand") {
+		mainLoop<HubbardOneOrbital<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="FeAsBasedSc") {
+		mainLoop<FeBasedSc<RealType,GeometryType,WordType> >(io,geometry);
+	} else {
+		std::cerr<<"No known model "<<model<<"\n";
+		return 1;
+	}
+}
+
+/*@}*/
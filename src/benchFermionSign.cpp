@@ -0,0 +1,217 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file benchFermionSign.cpp
+ *
+ *  Times the kernels of FermionSign.h against the loops over sites they
+ *  replaced in the bases: the sign of a hop, as setHoppingTerm asks for
+ *  it, and the gathering of one orbital of a ket, with pext if the cpu
+ *  has it and with the portable loop. Checks first that the old and
+ *  new kernels agree on all the kets
+ *
+ *  Usage: benchFermionSign [-n sites] [-o orbitals] [-k kets] [-r repetitions]
+ *
+ */
+#include <unistd.h>
+#include <cstdlib>
+#include <ctime>
+#include <getopt.h>
+#include <iostream>
+#include <vector>
+#include "FermionSign.h"
+
+using namespace LanczosPlusPlus;
+
+#if defined(USE_MULTIWORD)
+typedef MultiWord<USE_MULTIWORD> WordType;
+#elif defined(USE_WORD128)
+typedef unsigned __int128 WordType;
+#else
+typedef unsigned long long WordType;
+#endif
+typedef BitWord<WordType> BitWordType;
+typedef FermionSign<WordType> FermionSignType;
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" [-n sites] [-o orbitals] [-k kets] [-r repetitions]\n";
+}
+
+//! Electrons of ket in [from,upto), one bit at a time, as the bases counted them
+size_t electronsLoop(const WordType& ket,size_t from,size_t upto)
+{
+	size_t sum = 0;
+	for (size_t c=from;c<upto;c++)
+		if (ket & BitWordType::bit(c)) sum++;
+	return sum;
+}
+
+//! The sign of a hop before FermionSign::hopSign
+int hopSignLoop(const WordType& ket,size_t i,size_t orb1,size_t j,size_t orb2,size_t orbitals)
+{
+	size_t sum = electronsLoop(ket,(i+1)*orbitals,j*orbitals);
+	sum += electronsLoop(ket,i*orbitals+orb1,(i+1)*orbitals);
+	sum += electronsLoop(ket,j*orbitals,j*orbitals+orb2);
+	return (sum & 1) ? -1 : 1;
+}
+
+//! Orbital orb of each site of ket, before FermionSign::extract
+WordType extractLoop(const WordType& ket,size_t orb,size_t nsite,size_t orbitals)
+{
+	WordType res = 0;
+	for (size_t site=0;site<nsite;site++)
+		if (ket & BitWordType::bit(site*orbitals+orb)) res |= BitWordType::bit(site);
+	return res;
+}
+
+double nanoseconds(clock_t start,double calls)
+{
+	return 1e9*double(clock()-start)/(double(CLOCKS_PER_SEC)*calls);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	size_t nsite = 16;
+	size_t orbitals = 3;
+	size_t nkets = 65536;
+	size_t reps = 20;
+	while ((opt = getopt(argc, argv, "n:o:k:r:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nsite = atoi(optarg);
+			break;
+		case 'o':
+			orbitals = atoi(optarg);
+			break;
+		case 'k':
+			nkets = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		default: /* '?' */
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	size_t bits = nsite*orbitals;
+	if (nsite==0 || orbitals==0 || bits>size_t(BitWordType::BITS) || nkets==0 || reps==0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	srand(7);
+	std::vector<WordType> kets(nkets,0);
+	for (size_t k=0;k<nkets;k++)
+		for (size_t b=0;b<bits;b++)
+			if (rand() & 1) kets[k] |= BitWordType::bit(b);
+
+	std::vector<WordType> orbitalMask(orbitals,0);
+	for (size_t orb=0;orb<orbitals;orb++)
+		for (size_t site=0;site<nsite;site++)
+			orbitalMask[orb] |= BitWordType::bit(site*orbitals+orb);
+
+	bool bmi2 = fermionSignBmi2();
+	size_t wrong = 0;
+	for (size_t k=0;k<nkets;k++) {
+		size_t orb1 = k%orbitals;
+		size_t orb2 = (k/orbitals)%orbitals;
+		for (size_t i=0;i<nsite;i++)
+			for (size_t j=i;j<nsite;j++)
+				if (hopSignLoop(kets[k],i,orb1,j,orb2,orbitals)!=
+				    FermionSignType::hopSign(kets[k],i,orb1,j,orb2,orbitals)) wrong++;
+
+		for (size_t orb=0;orb<orbitals;orb++) {
+			WordType x = extractLoop(kets[k],orb,nsite,orbitals);
+			WordType y = kets[k] & orbitalMask[orb];
+			if (x!=FermionSignType::extract(kets[k],orbitalMask[orb],bmi2)) wrong++;
+			if (x!=FermionSignType::extract(kets[k],orbitalMask[orb],false)) wrong++;
+			if (y!=FermionSignType::deposit(x,orbitalMask[orb],bmi2)) wrong++;
+			if (y!=FermionSignType::deposit(x,orbitalMask[orb],false)) wrong++;
+		}
+	}
+
+	std::cout<<"sites="<<nsite<<" orbitals="<<orbitals<<" kets="<<nkets;
+	std::cout<<" bmi2="<<bmi2<<" wrong="<<wrong<<"\n";
+
+	// one hop from each site, to a site that changes with the ket
+	long sink = 0;
+	double hops = double(reps)*nkets*nsite;
+	clock_t start = clock();
+	for (size_t r=0;r<reps;r++) {
+		for (size_t k=0;k<nkets;k++) {
+			for (size_t i=0;i<nsite;i++) {
+				size_t j = (i+1+k)%nsite;
+				size_t a = (i<j) ? i : j;
+				size_t b = (i<j) ? j : i;
+				sink += hopSignLoop(kets[k],a,k%orbitals,b,r%orbitals,orbitals);
+			}
+		}
+	}
+	double loop = nanoseconds(start,hops);
+
+	start = clock();
+	for (size_t r=0;r<reps;r++) {
+		for (size_t k=0;k<nkets;k++) {
+			for (size_t i=0;i<nsite;i++) {
+				size_t j = (i+1+k)%nsite;
+				size_t a = (i<j) ? i : j;
+				size_t b = (i<j) ? j : i;
+				sink += FermionSignType::hopSign(kets[k],a,k%orbitals,b,r%orbitals,orbitals);
+			}
+		}
+	}
+	double masked = nanoseconds(start,hops);
+	std::cout<<"ns per hop sign: loop="<<loop<<" mask+popcount="<<masked<<"\n";
+
+	WordType gathered = 0;
+	double calls = double(reps)*nkets*orbitals;
+	start = clock();
+	for (size_t r=0;r<reps;r++)
+		for (size_t k=0;k<nkets;k++)
+			for (size_t orb=0;orb<orbitals;orb++)
+				gathered ^= extractLoop(kets[k],orb,nsite,orbitals);
+	loop = nanoseconds(start,calls);
+
+	start = clock();
+	for (size_t r=0;r<reps;r++)
+		for (size_t k=0;k<nkets;k++)
+			for (size_t orb=0;orb<orbitals;orb++)
+				gathered ^= FermionSignType::extract(kets[k],orbitalMask[orb],bmi2);
+	double fast = nanoseconds(start,calls);
+
+	start = clock();
+	for (size_t r=0;r<reps;r++)
+		for (size_t k=0;k<nkets;k++)
+			for (size_t orb=0;orb<orbitals;orb++)
+				gathered ^= FermionSignType::extract(kets[k],orbitalMask[orb],false);
+	double portable = nanoseconds(start,calls);
+	std::cout<<"ns per orbital gather: loop="<<loop<<" extract="<<fast;
+	std::cout<<" portable="<<portable<<"\n";
+
+	// keeps the loops above from being optimized away
+	if (sink==0 && !gathered) std::cout<<"\n";
+	return (wrong==0) ? 0 : 1;
+}
+
+/*@}*/
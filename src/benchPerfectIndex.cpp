@@ -0,0 +1,122 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file benchPerfectIndex.cpp
+ *
+ *  Times BasisOneSpin::perfectIndex, which reads one table entry per
+ *  chunk of bits, against the loop over single bits it replaced, and
+ *  checks that both give the index of every state of the basis
+ *
+ *  Usage: benchPerfectIndex -n sites -p electrons [-r repetitions]
+ *
+ */
+#include <unistd.h>
+#include <cstdlib>
+#include <ctime>
+#include <getopt.h>
+#include <iostream>
+#include "BasisOneSpin.h"
+
+using namespace LanczosPlusPlus;
+
+#if defined(USE_MULTIWORD)
+typedef MultiWord<USE_MULTIWORD> WordType;
+#elif defined(USE_WORD128)
+typedef unsigned __int128 WordType;
+#else
+typedef unsigned long long WordType;
+#endif
+typedef BasisOneSpin<WordType> BasisType;
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -n sites -p electrons [-r repetitions]\n";
+}
+
+//! The rank as perfectIndex computed it before, one set bit at a time
+size_t perfectIndexLoop(const Binomial& comb,WordType state)
+{
+	size_t n=0;
+	for (size_t b=0,c=1;state>0;b++,state>>=1)
+		if (state & 1) n += comb(b,c++);
+	return n;
+}
+
+double nanoseconds(clock_t start,size_t calls)
+{
+	return 1e9*double(clock()-start)/(double(CLOCKS_PER_SEC)*calls);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	size_t nsite = 0;
+	size_t npart = 0;
+	size_t reps = 10;
+	while ((opt = getopt(argc, argv, "n:p:r:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nsite = atoi(optarg);
+			break;
+		case 'p':
+			npart = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		default: /* '?' */
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (nsite==0 || npart>nsite || reps==0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	BasisType basis(nsite,npart);
+	Binomial comb(nsite);
+	size_t size = basis.size();
+
+	size_t wrong = 0;
+	for (size_t i=0;i<size;i++)
+		if (basis.perfectIndex(basis[i])!=i || perfectIndexLoop(comb,basis[i])!=i)
+			wrong++;
+
+	volatile size_t sink = 0;
+	clock_t start = clock();
+	for (size_t r=0;r<reps;r++)
+		for (size_t i=0;i<size;i++) sink += perfectIndexLoop(comb,basis[i]);
+	double loop = nanoseconds(start,reps*size);
+
+	start = clock();
+	for (size_t r=0;r<reps;r++)
+		for (size_t i=0;i<size;i++) sink += basis.perfectIndex(basis[i]);
+	double chunked = nanoseconds(start,reps*size);
+
+	std::cout<<"sites="<<nsite<<" electrons="<<npart<<" states="<<size;
+	std::cout<<" wrong="<<wrong<<"\n";
+	std::cout<<"ns per call: loop="<<loop<<" chunked="<<chunked<<"\n";
+	return (wrong==0) ? 0 : 1;
+}
+
+/*@}*/
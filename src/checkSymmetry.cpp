@@ -0,0 +1,267 @@
+/*
+// BEGIN LICENSE BLOCK
+Copyright (c) 2009-2012, UT-Battelle, LLC
+All rights reserved
+
+[Lanczos++, Version 1.0.0]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+
+/** \ingroup LanczosPlusPlus */
+/*@{*/
+
+/*! \file checkSymmetry.cpp
+ *
+ *  Checks the sectors of the symmetry that the input of lanczos selects
+ *  against the dense transform*H*transform^dagger, with the rows of the
+ *  transform taken from the columns of each sector (see
+ *  SymmetryBlockBuilder.h). The transform must be unitary, each block
+ *  of transform*H*transform^dagger must be the Hamiltonian that init()
+ *  builds for its sector, the other entries must vanish, and
+ *  transformGs must apply transform^dagger. Fillings with an even
+ *  number of electrons of a spin test the fermion signs
+ *
+ *  Usage: checkSymmetry -f filename; returns 1 if an error is above
+ *  the tolerance. The Hilbert space must be small, it is stored dense.
+ *  make check runs it on the inputs in TestSuite
+ *
+ */
+#include <unistd.h>
+#include <cstdlib>
+#include <getopt.h>
+#include <complex>
+#include "ProgramGlobals.h"
+
+#include "Tj1Orb.h"
+#include "Immm.h"
+#include "HubbardOneOrbital.h"
+#include "FeBasedSc.h"
+
+#include "Geometry.h"
+#include "IoSimple.h" // in PsimagLite
+#include "ParametersEngine.h"
+#include "ReflectionSymmetry.h"
+#include "TranslationSymmetry.h"
+#include "SpinFlipSymmetry.h"
+#include "GroupSymmetry.h"
+
+using namespace LanczosPlusPlus;
+
+typedef double RealType;
+typedef PsimagLite::Geometry<RealType,ProgramGlobals> GeometryType;
+typedef PsimagLite::IoSimple::In IoInputType;
+#if defined(USE_MULTIWORD)
+typedef MultiWord<USE_MULTIWORD> WordType;
+#elif defined(USE_WORD128)
+typedef unsigned __int128 WordType;
+#else
+typedef unsigned long long WordType;
+#endif
+
+static const size_t MAX_HILBERT = 2000;
+static const RealType TOLERANCE = 1e-10;
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -f filename\n";
+}
+
+RealType conjugate(const RealType& value) { return value; }
+
+std::complex<RealType> conjugate(const std::complex<RealType>& value)
+{
+	return std::conj(value);
+}
+
+template<typename FieldType>
+RealType maxAbs(const std::vector<FieldType>& v)
+{
+	RealType res = 0;
+	for (size_t i=0;i<v.size();i++)
+		res = std::max(res,RealType(std::abs(v[i])));
+	return res;
+}
+
+template<typename ModelType,typename SymmetryType>
+bool check(const ModelType& model,const GeometryType& geometry,const ParametersEngine<RealType>& params)
+{
+	typedef typename SymmetryType::VectorType VectorType;
+	typedef typename VectorType::value_type FieldType;
+	typedef typename SymmetryType::SectorType SectorType;
+
+	size_t hilbert = model.size();
+	if (hilbert>MAX_HILBERT)
+		throw std::runtime_error("checkSymmetry: Hilbert space too large\n");
+
+	SymmetryType symmetry(model.basis(),geometry,params);
+	symmetry.init(model,model.basis());
+
+	typename ModelType::SparseMatrixType matrix;
+	model.setupHamiltonian(matrix,model.basis(),1);
+
+	// row offset+b of the transform is sector s at row b; rows has its non-zeros
+	PsimagLite::Matrix<FieldType> transform(hilbert,hilbert);
+	std::vector<std::vector<std::pair<size_t,FieldType> > > rows(hilbert);
+	std::vector<size_t> offsets(1,0);
+	for (size_t s=0;s<symmetry.sectors();s++) {
+		SectorType sector = symmetry.sector(s);
+		size_t b = 0;
+		FieldType value = 0;
+		for (size_t t=0;t<hilbert;t++) {
+			if (!sector.column(t,b,value)) continue;
+			if (offsets[s]+b>=hilbert)
+				throw std::runtime_error("checkSymmetry: sectors do not add up to the Hilbert space\n");
+			transform(offsets[s]+b,t) = conjugate(value);
+			rows[offsets[s]+b].push_back(std::pair<size_t,FieldType>(t,conjugate(value)));
+		}
+		offsets.push_back(offsets[s]+sector.size());
+	}
+	if (offsets.back()!=hilbert)
+		throw std::runtime_error("checkSymmetry: sectors do not add up to the Hilbert space\n");
+
+	std::vector<FieldType> row(hilbert);
+	RealType errUnitary = 0;
+	for (size_t a=0;a<hilbert;a++) {
+		for (size_t b=0;b<hilbert;b++) row[b] = (a==b) ? -1 : 0;
+		for (size_t k=0;k<rows[a].size();k++) {
+			size_t t = rows[a][k].first;
+			for (size_t b=0;b<hilbert;b++)
+				row[b] += rows[a][k].second*conjugate(transform(b,t));
+		}
+		errUnitary = std::max(errUnitary,maxAbs(row));
+	}
+
+	// H transform^dagger, column b
+	PsimagLite::Matrix<FieldType> hTransform(hilbert,hilbert);
+	for (size_t t=0;t<hilbert;t++)
+		for (int k=matrix.getRowPtr(t);k<matrix.getRowPtr(t+1);k++)
+			for (size_t b=0;b<hilbert;b++)
+				hTransform(t,b) += matrix.getValue(k)*conjugate(transform(b,matrix.getCol(k)));
+
+	RealType errBlocks = 0;
+	RealType errGs = 0;
+	for (size_t s=0;s<symmetry.sectors();s++) {
+		size_t rank = offsets[s+1]-offsets[s];
+		if (rank==0) continue;
+		symmetry.setPointer(s);
+		if (symmetry.rank()!=rank)
+			throw std::runtime_error("checkSymmetry: sector and Hamiltonian sizes differ\n");
+		for (size_t b=0;b<hilbert;b++) {
+			// column b of transform*H*transform^dagger, minus the block
+			VectorType column(rank,0);
+			if (b>=offsets[s] && b<offsets[s+1]) {
+				VectorType unit(rank,0);
+				unit[b-offsets[s]] = 1;
+				symmetry.matrixVectorProduct(column,unit);
+				for (size_t a=0;a<rank;a++) column[a] = -column[a];
+			}
+			for (size_t a=0;a<rank;a++) {
+				const std::vector<std::pair<size_t,FieldType> >& r = rows[offsets[s]+a];
+				for (size_t k=0;k<r.size();k++)
+					column[a] += r[k].second*hTransform(r[k].first,b);
+			}
+			errBlocks = std::max(errBlocks,maxAbs(column));
+		}
+
+		VectorType gs(rank);
+		for (size_t a=0;a<rank;a++) gs[a] = RealType(a+1)/rank;
+		VectorType expected(hilbert,0);
+		for (size_t a=0;a<rank;a++) {
+			const std::vector<std::pair<size_t,FieldType> >& r = rows[offsets[s]+a];
+			for (size_t k=0;k<r.size();k++)
+				expected[r[k].first] += conjugate(r[k].second)*gs[a];
+		}
+		symmetry.transformGs(gs,offsets[s]);
+		for (size_t t=0;t<hilbert;t++) expected[t] -= gs[t];
+		errGs = std::max(errGs,maxAbs(expected));
+	}
+
+	std::cout<<"hilbert="<<hilbert<<" sectors="<<symmetry.sectors();
+	std::cout<<" unitary="<<errUnitary<<" blocks="<<errBlocks<<" gs="<<errGs<<"\n";
+	return (errUnitary<TOLERANCE && errBlocks<TOLERANCE && errGs<TOLERANCE);
+}
+
+template<typename ModelType>
+bool mainLoop(IoInputType& io,const GeometryType& geometry)
+{
+	typedef typename ModelType::ParametersModelType ParametersModelType;
+	typedef typename ModelType::BasisType BasisType;
+
+	ParametersModelType mp(io);
+	size_t nup = 0;
+	size_t ndown = 0;
+	io.readline(nup,"TargetElectronsUp=");
+	io.readline(ndown,"TargetElectronsDown=");
+	ModelType model(nup,ndown,mp,geometry);
+
+	ParametersEngine<RealType> params(io);
+
+	// as lanczos.cpp chooses
+	if (params.useGroupSymmetry) {
+		std::cout<<"#GroupSymmetry\n";
+		return check<ModelType,GroupSymmetry<GeometryType,BasisType> >(model,geometry,params);
+	} else if (params.useSpinFlipSymmetry) {
+		std::cout<<"#SpinFlipSymmetry\n";
+		return check<ModelType,SpinFlipSymmetry<GeometryType,BasisType> >(model,geometry,params);
+	} else if (params.useTranslationSymmetry) {
+		std::cout<<"#TranslationSymmetry\n";
+		return check<ModelType,TranslationSymmetry<GeometryType,BasisType> >(model,geometry,params);
+	} else if (params.useReflectionSymmetry) {
+		std::cout<<"#ReflectionSymmetry\n";
+		return check<ModelType,ReflectionSymmetry<GeometryType,BasisType> >(model,geometry,params);
+	}
+	throw std::runtime_error("checkSymmetry: the input selects no symmetry\n");
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	std::string file = "";
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		default: /* '?' */
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (file == "") {
+		usage(argv[0]);
+		return 1;
+	}
+
+	IoInputType io(file);
+	GeometryType geometry(io);
+
+	std::string model("");
+	io.readline(model,"Model=");
+
+	bool ok = false;
+	if (model=="Tj1Orb") {
+		ok = mainLoop<Tj1Orb<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="Immm") {
+		ok = mainLoop<Immm<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="HubbardOneBand") {
+		ok = mainLoop<HubbardOneOrbital<RealType,GeometryType,WordType> >(io,geometry);
+	} else if (model=="FeAsBasedSc") {
+		ok = mainLoop<FeBasedSc<RealType,GeometryType,WordType> >(io,geometry);
+	} else {
+		std::cerr<<"No known model "<<model<<"\n";
+		return 1;
+	}
+	return (ok) ? 0 : 1;
+}
+
+/*@}*/
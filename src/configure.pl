@@ -27,7 +27,9 @@ my $mpi=0;
 my $platform="linux";
 my $lapack="-llapack";
 my $PsimagLite="../../PsimagLite/src";
-my ($pthreads,$pthreadsLib)=(0,"");
+my ($pthreads,$pthreadsLib)=(1,"-lpthread");
+my $wordBits=64; # 128 for up to 128 spin-orbitals, needs unsigned __int128
+                 # 192, 256, ... for more, with MultiWord.h
 my $brand= "v1.0";
 
 
@@ -50,11 +52,15 @@ createMakefile();
 
 sub createMakefile
 {
+	die "$0: wordBits must be a multiple of 64\n" if ($wordBits%64);
 	system("cp Makefile Makefile.bak") if (-r "Makefile");
 	my $compiler = compilerName();
 	open(FOUT,">Makefile") or die "Cannot open Makefile for writing: $!\n";
 	my $usePthreadsOrNot = " ";
 	$usePthreadsOrNot = " -DUSE_PTHREADS " if ($pthreads);
+	my $wordFlags = " ";
+	$wordFlags = " -DUSE_WORD128 " if ($wordBits==128);
+	$wordFlags = " -DUSE_MULTIWORD=".($wordBits/64)." " if ($wordBits>128);
 
 print FOUT<<EOF;
 # DO NOT EDIT!!! Changes will be lost. Modify configure.pl instead
@@ -64,7 +70,7 @@ print FOUT<<EOF;
 # MPI: $mpi
 
 LDFLAGS =    $lapack  $gslLibs $pthreadsLib
-CPPFLAGS = -Werror -Wall  -IEngine -IModels/Tj1Orb -IModels/Immm -IModels/HubbardOneOrbital -IModels/FeBasedSc -I$PsimagLite/Geometry -I$PsimagLite $usePthreadsOrNot
+CPPFLAGS = -Werror -Wall  -IEngine -IModels/Tj1Orb -IModels/Immm -IModels/HubbardOneOrbital -IModels/FeBasedSc -I$PsimagLite/Geometry -I$PsimagLite $usePthreadsOrNot $wordFlags
 EOF
 if ($mpi) {
 	print FOUT "CXX = mpicxx -O3 -DNDEBUG \n";
@@ -77,23 +83,38 @@ if ($mpi) {
 }
 print FOUT<<EOF;
 EXENAME = lanczos
+BENCH = benchAllocations benchFermionSign benchPerfectIndex
+CHECK = checkSymmetry
+CHECK_INPUTS = TestSuite/checkHubbardRing.inp TestSuite/checkTjRing.inp TestSuite/checkHubbardTorus.inp
 all: \$(EXENAME)
 
+bench: \$(BENCH)
+
+# fails on the first input whose sectors do not match the dense transform
+check: \$(CHECK)
+	for i in \$(CHECK_INPUTS); do ./checkSymmetry -f \$\$i || exit 1; done
+
 lanczos.cpp: configure.pl
 	perl configure.pl
 
 lanczos:  lanczos.o 
 	\$(CXX) -o lanczos lanczos.o \$(LDFLAGS)  
 
+bench%: bench%.o
+	\$(CXX) -o \$@ \$< \$(LDFLAGS)
+
+check%: check%.o
+	\$(CXX) -o \$@ \$< \$(LDFLAGS)
+
 # dependencies brought about by Makefile.dep
 %.o: %.cpp Makefile
 	\$(CXX) \$(CPPFLAGS) -c \$< 
 
-Makefile.dep: lanczos.cpp
-	\$(CXX) \$(CPPFLAGS) -MM lanczos.cpp  > Makefile.dep
+Makefile.dep: lanczos.cpp \$(BENCH:=.cpp) \$(CHECK:=.cpp)
+	\$(CXX) \$(CPPFLAGS) -MM lanczos.cpp \$(BENCH:=.cpp) \$(CHECK:=.cpp) > Makefile.dep
 
 clean:
-	rm -f core* \$(EXENAME) *.o Makefile.dep
+	rm -f core* \$(EXENAME) \$(BENCH) \$(CHECK) *.o Makefile.dep
 
 include Makefile.dep
 
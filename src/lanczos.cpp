@@ -29,6 +29,7 @@ std::string license = "Copyright (c) 2009-2012, UT-Battelle, LLC\n"
 
 #include "Geometry.h"
 #include "InternalProductStored.h"
+#include "InternalProductOnTheFly.h"
 #include "IoSimple.h" // in PsimagLite
 #include "ProgramGlobals.h"
 #include "ContinuedFraction.h" // in PsimagLite 
@@ -36,7 +37,10 @@ std::string license = "Copyright (c) 2009-2012, UT-Battelle, LLC\n"
 #include "DefaultSymmetry.h"
 #include "ReflectionSymmetry.h"
 #include "TranslationSymmetry.h"
+#include "SpinFlipSymmetry.h"
+#include "GroupSymmetry.h"
 #include "Split.h"
+#include "ParametersEngine.h"
 
 using namespace LanczosPlusPlus;
 
@@ -45,6 +49,13 @@ typedef std::complex<RealType> ComplexType;
 typedef PsimagLite::ConcurrencySerial<RealType> ConcurrencyType;
 typedef PsimagLite::Geometry<RealType,ProgramGlobals> GeometryType;
 typedef PsimagLite::IoSimple::In IoInputType;
+#if defined(USE_MULTIWORD)
+typedef MultiWord<USE_MULTIWORD> WordType;
+#elif defined(USE_WORD128)
+typedef unsigned __int128 WordType;
+#else
+typedef unsigned long long WordType;
+#endif
 
 void usage(const char *progName)
 {
@@ -61,11 +72,12 @@ size_t maxOrbitals(const ModelType& model)
 	return res;
 }
 
-template<typename ModelType,typename SpecialSymmetryType>
+template<typename ModelType,
+         template<typename,typename> class InternalProductTemplate,
+         typename SpecialSymmetryType>
 void mainLoop2(ModelType& model,IoInputType& io,const GeometryType& geometry,size_t gf,std::vector<size_t>& sites,size_t cicj)
 {
-	typedef typename ModelType::BasisType BasisType;
-	typedef Engine<ModelType,InternalProductStored,SpecialSymmetryType,ConcurrencyType> EngineType;
+	typedef Engine<ModelType,InternalProductTemplate,SpecialSymmetryType,ConcurrencyType> EngineType;
 	typedef typename EngineType::TridiagonalMatrixType TridiagonalMatrixType;
 
 	EngineType engine(model,geometry.numberOfSites(),io);
@@ -105,6 +117,24 @@ void mainLoop2(ModelType& model,IoInputType& io,const GeometryType& geometry,siz
 	}
 }
 
+//! UseOnTheFly=1 needs a model with HAS_ON_THE_FLY set
+template<typename ModelType,bool hasOnTheFly>
+struct OnTheFly {
+	static void mainLoop(ModelType& model,IoInputType& io,const GeometryType& geometry,size_t gf,std::vector<size_t>& sites,size_t cicj)
+	{
+		throw std::runtime_error("UseOnTheFly=1 is not supported by this model\n");
+	}
+};
+
+template<typename ModelType>
+struct OnTheFly<ModelType,true> {
+	static void mainLoop(ModelType& model,IoInputType& io,const GeometryType& geometry,size_t gf,std::vector<size_t>& sites,size_t cicj)
+	{
+		typedef typename ModelType::BasisType BasisType;
+		mainLoop2<ModelType,InternalProductOnTheFly,DefaultSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+	}
+};
+
 template<typename ModelType>
 void mainLoop(IoInputType& io,const GeometryType& geometry,size_t gf,std::vector<size_t>& sites,size_t cicj)
 {
@@ -120,28 +150,30 @@ void mainLoop(IoInputType& io,const GeometryType& geometry,size_t gf,std::vector
 	io.readline(nup,"TargetElectronsUp=");
 	io.readline(ndown,"TargetElectronsDown=");
 
+	// threads to build the basis, as for the Hamiltonian
+	ParametersEngine<RealType> params(io);
+
 	//! Setup the Model
-	ModelType model(nup,ndown,mp,geometry);
-
-	int tmp = 0;
-	try {
-		io.readline(tmp,"UseTranslationSymmetry=");
-	} catch(std::exception& e) {}
-	io.rewind();
-	bool useTranslationSymmetry = (tmp==1) ? true : false;
-
-	try {
-		io.readline(tmp,"UseReflectionSymmetry=");
-	} catch(std::exception& e) {}
-	io.rewind();
-	bool useReflectionSymmetry = (tmp==1) ? true : false;
-
-	if (useTranslationSymmetry) {
-		mainLoop2<ModelType,TranslationSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
-	} else if (useReflectionSymmetry) {
-		mainLoop2<ModelType,ReflectionSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+	ModelType model(nup,ndown,mp,geometry,params.threads);
+
+	// the symmetries together only with UseGroupSymmetry=1, see GroupSymmetry.h
+	if (params.useOnTheFly) {
+		if (params.useTranslationSymmetry || params.useReflectionSymmetry ||
+		    params.useSpinFlipSymmetry || params.useGroupSymmetry)
+			throw std::runtime_error("UseOnTheFly=1 cannot be used with symmetries\n");
+		OnTheFly<ModelType,ModelType::HAS_ON_THE_FLY>::mainLoop(model,io,geometry,gf,sites,cicj);
+	} else if (params.useGroupSymmetry) {
+		mainLoop2<ModelType,InternalProductStored,GroupSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+	} else if (params.useSpinFlipSymmetry) {
+		if (params.useTranslationSymmetry)
+			throw std::runtime_error("UseSpinFlipSymmetry=1 with UseTranslationSymmetry=1 needs UseGroupSymmetry=1\n");
+		mainLoop2<ModelType,InternalProductStored,SpinFlipSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+	} else if (params.useTranslationSymmetry) {
+		mainLoop2<ModelType,InternalProductStored,TranslationSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+	} else if (params.useReflectionSymmetry) {
+		mainLoop2<ModelType,InternalProductStored,ReflectionSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
 	} else {
-		mainLoop2<ModelType,DefaultSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
+		mainLoop2<ModelType,InternalProductStored,DefaultSymmetry<GeometryType,BasisType> >(model,io,geometry,gf,sites,cicj);
 	}
 }
 
@@ -187,13 +219,13 @@ int main(int argc,char *argv[])
 	io.readline(model,"Model=");
 
 	if (model=="Tj1Orb") {
-		mainLoop<Tj1Orb<RealType,GeometryType> >(io,geometry,gf,sites,cicj);
+		mainLoop<Tj1Orb<RealType,GeometryType,WordType> >(io,geometry,gf,sites,cicj);
 	} else if (model=="Immm") {
-		mainLoop<Immm<RealType,GeometryType> >(io,geometry,gf,sites,cicj);
+		mainLoop<Immm<RealType,GeometryType,WordType> >(io,geometry,gf,sites,cicj);
 	} else if (model=="HubbardOneBand") {
-		mainLoop<HubbardOneOrbital<RealType,GeometryType> >(io,geometry,gf,sites,cicj);
+		mainLoop<HubbardOneOrbital<RealType,GeometryType,WordType> >(io,geometry,gf,sites,cicj);
 	} else if (model=="FeAsBasedSc") {
-		mainLoop<FeBasedSc<RealType,GeometryType> >(io,geometry,gf,sites,cicj);
+		mainLoop<FeBasedSc<RealType,GeometryType,WordType> >(io,geometry,gf,sites,cicj);
 	} else {
 		std::cerr<<"No known model "<<model<<"\n";
 		return 1;